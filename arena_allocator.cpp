@@ -0,0 +1,93 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#include "arena_allocator.h"
+
+#include <iterator>
+
+ArenaAllocator::ArenaAllocator(uint32_t capacity)
+    : m_Capacity{capacity}, m_FreeSpace{capacity} {
+    if (capacity) {
+        insert_block(0, capacity);
+    }
+}
+
+uint32_t ArenaAllocator::allocate(uint32_t size) noexcept {
+    if (size == 0) return INVALID_OFFSET;
+
+    auto fit = m_BlocksBySize.lower_bound(size);
+    if (fit == m_BlocksBySize.end()) return INVALID_OFFSET;
+
+    return take_from(m_BlocksByOffset.find(fit->second), size);
+}
+
+uint32_t ArenaAllocator::allocate_lowest(uint32_t size, uint32_t limit) noexcept {
+    if (size == 0) return INVALID_OFFSET;
+
+    for (auto block = m_BlocksByOffset.begin(); block != m_BlocksByOffset.end() && block->first < limit; ++block) {
+        if (block->second >= size) {
+            return take_from(block, size);
+        }
+    }
+    return INVALID_OFFSET;
+}
+
+void ArenaAllocator::free(uint32_t offset, uint32_t size) noexcept {
+    if (size == 0) return;
+    m_FreeSpace += size;
+
+    auto next = m_BlocksByOffset.lower_bound(offset);
+    if (next != m_BlocksByOffset.end() && offset + size == next->first) {
+        size += next->second;
+        next = std::next(next);
+        erase_block(std::prev(next));
+    }
+    if (next != m_BlocksByOffset.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            erase_block(previous);
+        }
+    }
+
+    insert_block(offset, size);
+}
+
+uint32_t ArenaAllocator::largest_free_block() const noexcept {
+    return m_BlocksBySize.empty() ? 0 : std::prev(m_BlocksBySize.end())->first;
+}
+
+float ArenaAllocator::fragmentation() const noexcept {
+    if (m_FreeSpace == 0) return 0.0f;
+    return 1.0f - static_cast<float>(largest_free_block()) / static_cast<float>(m_FreeSpace);
+}
+
+uint32_t ArenaAllocator::take_from(std::map<uint32_t, uint32_t>::iterator block, uint32_t size) {
+    const uint32_t offset = block->first;
+    const uint32_t block_size = block->second;
+    erase_block(block);
+    if (block_size > size) {
+        insert_block(offset + size, block_size - size);
+    }
+
+    m_FreeSpace -= size;
+    return offset;
+}
+
+void ArenaAllocator::insert_block(uint32_t offset, uint32_t size) {
+    m_BlocksByOffset.emplace(offset, size);
+    m_BlocksBySize.emplace(size, offset);
+}
+
+void ArenaAllocator::erase_block(std::map<uint32_t, uint32_t>::iterator block) noexcept {
+    auto [first, last] = m_BlocksBySize.equal_range(block->second);
+    for (auto it = first; it != last; ++it) {
+        if (it->second == block->first) {
+            m_BlocksBySize.erase(it);
+            break;
+        }
+    }
+    m_BlocksByOffset.erase(block);
+}
@@ -0,0 +1,618 @@
+//
+// Created by ctlf on 10/18/26.
+//
+// diggy_bench: generates a fixed, seeded set of chunks per scenario and reports
+// mean/p99 time per chunk for every stage, voxels/s and heap allocations per
+// chunk, then does the same for meshing those chunks, and times frustum
+// culling of a view's worth of chunk sections (reported as culled boxes/s
+// rather than per voxel). Results are written as JSON; --compare checks them
+// against an older result file and fails when a stage got slower than the
+// threshold allows, or when implementations that must agree (SIMD and scalar
+// culling, binary and culled meshing) disagree more often than before.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "frustum.h"
+#include "json.h"
+#include "mesher.h"
+#include "worldgen.h"
+
+// Every heap allocation made by the process goes through these, so the
+// counter can be sampled around the measured code. The deletes stay out of
+// line so GCC does not flag the malloc/free pairing as mismatched.
+static std::atomic<size_t> s_Allocations{0};
+
+void* operator new(size_t size) {
+    s_Allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+constexpr uint32_t BENCH_SEED = 1337;
+constexpr int RESULT_FORMAT_VERSION = 1;
+
+using clock_type = std::chrono::steady_clock;
+
+struct Options {
+    std::string output = "bench_results.json";
+    std::string compare;
+    int iterations = 3;
+    double threshold = 0.10;
+};
+
+struct Scenario {
+    const char* name;
+    std::vector<ChunkCoord> chunks;
+};
+
+// Per-chunk samples of every stage of one scenario.
+struct StageSamples {
+    std::vector<std::string> stage_names;
+    std::vector<std::vector<double>> milliseconds;
+    size_t chunks = 0;
+    size_t allocations = 0;
+    double total_seconds = 0.0;
+    // Off for suites that do not work on voxels, which then leave voxels/s
+    // and allocations/chunk out of their results.
+    bool per_voxel = true;
+
+    // Extra per-suite numbers, reported as-is.
+    std::vector<std::pair<std::string, double>> metrics;
+
+    explicit StageSamples(std::vector<std::string> names)
+        : stage_names{std::move(names)}, milliseconds(stage_names.size()) {}
+};
+
+static std::vector<ChunkCoord> chunk_box(ChunkCoord from, ChunkCoord to) {
+    std::vector<ChunkCoord> chunks;
+    for (int32_t y = from.y; y <= to.y; y++) {
+        for (int32_t z = from.z; z <= to.z; z++) {
+            for (int32_t x = from.x; x <= to.x; x++) {
+                chunks.push_back({x, y, z});
+            }
+        }
+    }
+    return chunks;
+}
+
+static std::vector<Scenario> make_scenarios() {
+    return {
+        // The surface band: heightmap and fill dominate, little to carve.
+        {"surface-heavy", chunk_box({-4, 0, -4}, {3, 0, 3})},
+        // Just below the surface, where every voxel is a cave candidate.
+        {"cave-heavy", chunk_box({-4, -2, -4}, {3, -1, 0})},
+        // Below the cave floor: solid stone and ores only.
+        {"deep-solid", chunk_box({-4, -12, -4}, {3, -12, 3})},
+    };
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    const size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+}
+
+static double mean(const std::vector<double>& values) {
+    if (values.empty()) return 0.0;
+    double sum = 0.0;
+    for (double v : values) sum += v;
+    return sum / values.size();
+}
+
+static StageSamples bench_generation(const Scenario& scenario, int iterations) {
+    std::vector<std::string> names;
+    for (size_t s = 0; s < GENERATION_STAGE_COUNT; s++) {
+        names.emplace_back(generation_stage_name(static_cast<GenerationStage>(s)));
+    }
+    names.emplace_back("total");
+
+    StageSamples samples{names};
+    const WorldGenerator generator{BENCH_SEED};
+    auto chunk = std::make_unique<Chunk>();
+
+    // Warm-up pass so page faults and cold caches are not measured.
+    for (const ChunkCoord& coord : scenario.chunks) {
+        generator.generate_chunk(coord, *chunk);
+    }
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        for (const ChunkCoord& coord : scenario.chunks) {
+            GenerationTimings timings{};
+
+            const size_t allocations_before = s_Allocations.load(std::memory_order_relaxed);
+            const clock_type::time_point start = clock_type::now();
+            generator.generate_chunk(coord, *chunk, &timings);
+            const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+            samples.allocations += s_Allocations.load(std::memory_order_relaxed) - allocations_before;
+
+            for (size_t s = 0; s < GENERATION_STAGE_COUNT; s++) {
+                samples.milliseconds[s].push_back(timings.seconds[s] * 1000.0);
+            }
+            samples.milliseconds.back().push_back(seconds * 1000.0);
+            samples.total_seconds += seconds;
+            samples.chunks++;
+        }
+    }
+
+    return samples;
+}
+
+// The scenario's chunks plus their face neighbours, generated up front so
+// only meshing is measured.
+class BenchWorld {
+public:
+    explicit BenchWorld(const Scenario& scenario) {
+        const WorldGenerator generator{BENCH_SEED};
+        for (const ChunkCoord& coord : scenario.chunks) {
+            for (int d = -1; d < static_cast<int>(FACE_DIRECTION_COUNT); d++) {
+                ChunkCoord c = coord;
+                if (d >= 0) {
+                    (d / 2 == 0 ? c.x : d / 2 == 1 ? c.y : c.z) += d % 2 ? 1 : -1;
+                }
+
+                auto& chunk = m_Chunks[c];
+                if (!chunk) {
+                    chunk = std::make_unique<Chunk>();
+                    generator.generate_chunk(c, *chunk);
+                }
+            }
+        }
+    }
+
+    ChunkNeighbourhood neighbourhood(ChunkCoord coord) const {
+        ChunkNeighbourhood result;
+        result.center = m_Chunks.at(coord).get();
+        result.neighbours[0] = m_Chunks.at({coord.x - 1, coord.y, coord.z}).get();
+        result.neighbours[1] = m_Chunks.at({coord.x + 1, coord.y, coord.z}).get();
+        result.neighbours[2] = m_Chunks.at({coord.x, coord.y - 1, coord.z}).get();
+        result.neighbours[3] = m_Chunks.at({coord.x, coord.y + 1, coord.z}).get();
+        result.neighbours[4] = m_Chunks.at({coord.x, coord.y, coord.z - 1}).get();
+        result.neighbours[5] = m_Chunks.at({coord.x, coord.y, coord.z + 1}).get();
+        return result;
+    }
+
+    size_t solid_voxels(ChunkCoord coord) const {
+        const Chunk& chunk = *m_Chunks.at(coord);
+        return static_cast<size_t>(std::count_if(std::begin(chunk.voxels), std::end(chunk.voxels), material_is_solid));
+    }
+
+private:
+    std::unordered_map<ChunkCoord, std::unique_ptr<Chunk>, ChunkCoordHash> m_Chunks;
+};
+
+struct MesherVariant {
+    const char* name;
+    void (ChunkMesher::*mesh)(const ChunkNeighbourhood&, MeshBuilder&) noexcept;
+    VertexLayout layout = VertexLayout::Float;
+    bool ambient_occlusion = true;
+    // As the game builds them, indices implied by the renderer's quad buffer.
+    bool shared_quad_indices = false;
+};
+
+static const MesherVariant s_MesherVariants[] {
+    {"culled", &ChunkMesher::mesh_culled},
+    {"greedy", &ChunkMesher::mesh_greedy},
+    {"binary", &ChunkMesher::mesh_binary},
+    {"binary_packed", &ChunkMesher::mesh_binary, VertexLayout::Packed, true, true},
+    {"binary_packed_no_ao", &ChunkMesher::mesh_binary, VertexLayout::Packed, false, true},
+};
+
+// Every section of a 17x5x17 chunk view box, as the game's VIEW_RADIUS_*
+// gives it, culled flat (without the region and chunk levels) against a
+// camera turning on the spot. Samples are per frame, in both paths.
+static StageSamples bench_culling(int iterations) {
+    constexpr int RADIUS_XZ = 8;
+    constexpr int RADIUS_Y = 2;
+    constexpr float VOXEL_SIZE = 2.0f;
+    constexpr int FRAMES = 24;
+
+    StageSamples samples{{"cull_simd", "cull_scalar"}};
+    samples.per_voxel = false;
+    const vec3 section_size{static_cast<float>(SECTION_SIZE) * VOXEL_SIZE};
+
+    AabbList boxes;
+    for (const ChunkCoord& coord : chunk_box({-RADIUS_XZ, -RADIUS_Y, -RADIUS_XZ}, {RADIUS_XZ, RADIUS_Y, RADIUS_XZ})) {
+        const vec3 origin = vec3{static_cast<float>(coord.x) * CHUNK_SIZE_X, static_cast<float>(coord.y) * CHUNK_SIZE_Y,
+            static_cast<float>(coord.z) * CHUNK_SIZE_Z} * VOXEL_SIZE;
+        for (size_t y = 0; y < CHUNK_SIZE_Y; y += SECTION_SIZE) {
+            for (size_t z = 0; z < CHUNK_SIZE_Z; z += SECTION_SIZE) {
+                for (size_t x = 0; x < CHUNK_SIZE_X; x += SECTION_SIZE) {
+                    const vec3 section_min = origin + vec3{static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)} * VOXEL_SIZE;
+                    boxes.add(section_min, section_min + section_size);
+                }
+            }
+        }
+        samples.chunks++;
+    }
+
+    const mat4 projection = glm::perspective(glm::radians(90.0f), 1280.0f / 720.0f, 0.01f, 1000.0f);
+    std::vector<CullResult> simd_results, scalar_results;
+    size_t visible = 0;
+    size_t mismatches = 0;
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        for (int frame = 0; frame < FRAMES; frame++) {
+            const float yaw = glm::radians(360.0f * frame / FRAMES);
+            const vec3 forward{std::sin(yaw), -0.25f, std::cos(yaw)};
+            const Frustum frustum = extract_frustum(projection * glm::lookAt(vec3{0.0f}, forward, vec3{0.0f, 1.0f, 0.0f}));
+
+            clock_type::time_point start = clock_type::now();
+            boxes.cull(frustum, simd_results);
+            const double simd_seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+            start = clock_type::now();
+            boxes.cull_scalar(frustum, scalar_results);
+            const double scalar_seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+            samples.milliseconds[0].push_back(simd_seconds * 1000.0);
+            samples.milliseconds[1].push_back(scalar_seconds * 1000.0);
+            samples.total_seconds += simd_seconds;
+
+            for (size_t i = 0; i < boxes.size(); i++) {
+                visible += simd_results[i] != CullResult::Outside;
+                mismatches += simd_results[i] != scalar_results[i];
+            }
+        }
+    }
+
+    const double frames = static_cast<double>(iterations) * FRAMES;
+    const double simd_ms = mean(samples.milliseconds[0]);
+    samples.metrics.emplace_back("sections_per_frame", static_cast<double>(boxes.size()));
+    samples.metrics.emplace_back("visible_sections_per_frame", static_cast<double>(visible) / frames);
+    samples.metrics.emplace_back("culled_aabbs_per_second", samples.total_seconds > 0.0
+        ? static_cast<double>(boxes.size()) * frames / samples.total_seconds : 0.0);
+    samples.metrics.emplace_back("simd_speedup", simd_ms > 0.0 ? mean(samples.milliseconds[1]) / simd_ms : 0.0);
+    samples.metrics.emplace_back("simd_scalar_mismatches", static_cast<double>(mismatches));
+    return samples;
+}
+
+// Every unit face a Float-layout mesh covers, keyed by FaceDirection, layer
+// along the face's axis and cell on it, with the tile drawn there. Quads are
+// read back from their four vertices, so merged quads count per cell.
+static std::unordered_map<uint32_t, float> covered_faces(const MeshBuffer& buffer) {
+    std::unordered_map<uint32_t, float> faces;
+
+    for (size_t quad = 0; quad + 4 * FLOATS_PER_VERTEX <= buffer.vertices.size(); quad += 4 * FLOATS_PER_VERTEX) {
+        const float* vertex = &buffer.vertices[quad];
+        const vec3 normal{vertex[3], vertex[4], vertex[5]};
+        const size_t axis = std::abs(normal.x) > 0.5f ? 0 : std::abs(normal.y) > 0.5f ? 1 : 2;
+        const size_t face = axis * 2 + (normal[axis] > 0.0f ? 1 : 0);
+        const size_t u_axis = axis == 0 ? 1 : 0;
+        const size_t v_axis = axis == 2 ? 1 : 2;
+
+        vec3 lo{vertex[0], vertex[1], vertex[2]};
+        vec3 hi = lo;
+        for (size_t corner = 1; corner < 4; corner++) {
+            const float* position = vertex + corner * FLOATS_PER_VERTEX;
+            lo = glm::min(lo, vec3{position[0], position[1], position[2]});
+            hi = glm::max(hi, vec3{position[0], position[1], position[2]});
+        }
+
+        const uint32_t layer = static_cast<uint32_t>(std::lround(lo[axis]));
+        for (uint32_t v = static_cast<uint32_t>(std::lround(lo[v_axis])); v < std::lround(hi[v_axis]); v++) {
+            for (uint32_t u = static_cast<uint32_t>(std::lround(lo[u_axis])); u < std::lround(hi[u_axis]); u++) {
+                faces[static_cast<uint32_t>(face) | layer << 3 | u << 9 | v << 15] = vertex[11];
+            }
+        }
+    }
+    return faces;
+}
+
+static StageSamples bench_meshing(const Scenario& scenario, int iterations) {
+    std::vector<std::string> names;
+    for (const MesherVariant& variant : s_MesherVariants) {
+        names.emplace_back(variant.name);
+    }
+
+    StageSamples samples{names};
+    const BenchWorld world{scenario};
+    auto mesher = std::make_unique<ChunkMesher>();
+    MeshBuffer buffer;
+
+    size_t naive_triangles = 0;
+    for (const ChunkCoord& coord : scenario.chunks) {
+        naive_triangles += world.solid_voxels(coord) * 12;
+    }
+    samples.metrics.emplace_back("naive_triangles_per_chunk", static_cast<double>(naive_triangles) / scenario.chunks.size());
+
+    for (size_t v = 0; v < std::size(s_MesherVariants); v++) {
+        const MesherVariant& variant = s_MesherVariants[v];
+        size_t triangles = 0;
+        size_t vertex_bytes = 0;
+        size_t index_bytes = 0;
+        buffer.layout = variant.layout;
+        buffer.shared_quad_indices = variant.shared_quad_indices;
+        mesher->set_ambient_occlusion(variant.ambient_occlusion);
+
+        // Warm-up pass, which also grows the reused buffer to its working size.
+        for (const ChunkCoord& coord : scenario.chunks) {
+            MeshBuilder builder{buffer};
+            builder.clear();
+            ((*mesher).*variant.mesh)(world.neighbourhood(coord), builder);
+            triangles += buffer.index_count() / 3;
+            index_bytes += buffer.indices.size() * sizeof(uint32_t);
+            vertex_bytes += buffer.vertices.size() * sizeof(float) + buffer.packed_vertices.size() * sizeof(PackedVertex);
+        }
+
+        for (int iteration = 0; iteration < iterations; iteration++) {
+            for (const ChunkCoord& coord : scenario.chunks) {
+                const ChunkNeighbourhood chunks = world.neighbourhood(coord);
+
+                const size_t allocations_before = s_Allocations.load(std::memory_order_relaxed);
+                const clock_type::time_point start = clock_type::now();
+                MeshBuilder builder{buffer};
+                builder.clear();
+                ((*mesher).*variant.mesh)(chunks, builder);
+                const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+                samples.allocations += s_Allocations.load(std::memory_order_relaxed) - allocations_before;
+
+                samples.milliseconds[v].push_back(seconds * 1000.0);
+                samples.total_seconds += seconds;
+                samples.chunks++;
+            }
+        }
+
+        samples.metrics.emplace_back(std::string(variant.name) + "_triangles_per_chunk",
+            static_cast<double>(triangles) / scenario.chunks.size());
+        samples.metrics.emplace_back(std::string(variant.name) + "_vertex_bytes_per_chunk",
+            static_cast<double>(vertex_bytes) / scenario.chunks.size());
+        samples.metrics.emplace_back(std::string(variant.name) + "_index_bytes_per_chunk",
+            static_cast<double>(index_bytes) / scenario.chunks.size());
+    }
+
+    // mesh_binary has to cover exactly the faces mesh_culled does, with the
+    // same tiles: cells covered by only one of them, or with another tile.
+    size_t mismatches = 0;
+    MeshBuffer culled_buffer;
+    buffer.layout = VertexLayout::Float;
+    buffer.shared_quad_indices = false;
+    mesher->set_ambient_occlusion(true);
+    for (const ChunkCoord& coord : scenario.chunks) {
+        const ChunkNeighbourhood chunks = world.neighbourhood(coord);
+        {
+            MeshBuilder builder{culled_buffer};
+            builder.clear();
+            mesher->mesh_culled(chunks, builder);
+        }
+        {
+            MeshBuilder builder{buffer};
+            builder.clear();
+            mesher->mesh_binary(chunks, builder);
+        }
+
+        const auto culled = covered_faces(culled_buffer);
+        const auto binary = covered_faces(buffer);
+        for (const auto& [cell, tile] : culled) {
+            const auto found = binary.find(cell);
+            mismatches += found == binary.end() || found->second != tile;
+        }
+        for (const auto& [cell, tile] : binary) {
+            mismatches += !culled.contains(cell);
+        }
+    }
+    samples.metrics.emplace_back("binary_culled_area_mismatches", static_cast<double>(mismatches));
+
+    // Share of binary_packed's meshing time spent on ambient occlusion.
+    auto variant_index = [](std::string_view name) {
+        return static_cast<size_t>(std::find_if(std::begin(s_MesherVariants), std::end(s_MesherVariants),
+            [name](const MesherVariant& variant) { return name == variant.name; }) - std::begin(s_MesherVariants));
+    };
+    const double with_ao = mean(samples.milliseconds[variant_index("binary_packed")]);
+    const double without_ao = mean(samples.milliseconds[variant_index("binary_packed_no_ao")]);
+    samples.metrics.emplace_back("ao_time_fraction", with_ao > 0.0 ? 1.0 - without_ao / with_ao : 0.0);
+
+    return samples;
+}
+
+static nlohmann::json summarize(const StageSamples& samples) {
+    nlohmann::json result;
+    result["chunks"] = samples.chunks;
+    if (samples.per_voxel) {
+        result["voxels_per_second"] = samples.total_seconds > 0.0
+            ? static_cast<double>(samples.chunks * CHUNK_VOLUME) / samples.total_seconds : 0.0;
+        result["allocations_per_chunk"] = samples.chunks ? static_cast<double>(samples.allocations) / samples.chunks : 0.0;
+    }
+
+    for (size_t s = 0; s < samples.stage_names.size(); s++) {
+        result["stages"][samples.stage_names[s]] = {
+            {"mean_ms", mean(samples.milliseconds[s])},
+            {"p99_ms", percentile(samples.milliseconds[s], 0.99)},
+        };
+    }
+    for (const auto& [name, value] : samples.metrics) {
+        result["metrics"][name] = value;
+    }
+    return result;
+}
+
+static void print_summary(const char* suite, const char* scenario, const nlohmann::json& result) {
+    if (result.contains("voxels_per_second")) {
+        printf("%s / %s: %zu chunks, %.3g voxels/s, %.1f allocations/chunk\n", suite, scenario,
+            result["chunks"].get<size_t>(), result["voxels_per_second"].get<double>(),
+            result["allocations_per_chunk"].get<double>());
+    }
+    else {
+        printf("%s / %s: %zu chunks\n", suite, scenario, result["chunks"].get<size_t>());
+    }
+
+    for (const auto& [stage, timing] : result["stages"].items()) {
+        printf("  %-20s mean %8.4f ms   p99 %8.4f ms\n", stage.c_str(),
+            timing["mean_ms"].get<double>(), timing["p99_ms"].get<double>());
+    }
+    if (result.contains("metrics")) {
+        for (const auto& [name, value] : result["metrics"].items()) {
+            printf("  %-44s %12.3f\n", name.c_str(), value.get<double>());
+        }
+    }
+}
+
+// Returns the number of stages whose mean regressed past the threshold.
+static int compare_results(const nlohmann::json& baseline, const nlohmann::json& current, double threshold) {
+    int regressions = 0;
+
+    for (const auto& [suite, scenarios] : current["suites"].items()) {
+        if (!baseline["suites"].contains(suite)) continue;
+
+        for (const auto& [scenario, result] : scenarios.items()) {
+            if (!baseline["suites"][suite].contains(scenario)) continue;
+            const nlohmann::json& old_result = baseline["suites"][suite][scenario];
+
+            for (const auto& [stage, timing] : result["stages"].items()) {
+                if (!old_result["stages"].contains(stage)) continue;
+
+                const double before = old_result["stages"][stage]["mean_ms"].get<double>();
+                const double after = timing["mean_ms"].get<double>();
+                if (before <= 0.0) continue;
+
+                const double change = (after - before) / before;
+                const bool regressed = change > threshold;
+                regressions += regressed;
+
+                printf("  %s %s/%s/%s: %.4f -> %.4f ms (%+.1f%%)\n", regressed ? "REGRESSION" : "ok        ",
+                    suite.c_str(), scenario.c_str(), stage.c_str(), before, after, change * 100.0);
+            }
+
+            // Mismatch counts check two implementations against each other;
+            // any more than before is a regression, whatever the threshold.
+            if (!result.contains("metrics")) continue;
+            for (const auto& [name, value] : result["metrics"].items()) {
+                if (!std::string_view{name}.ends_with("_mismatches")) continue;
+
+                const double before = old_result.contains("metrics") && old_result["metrics"].contains(name)
+                    ? old_result["metrics"][name].get<double>() : 0.0;
+                const double after = value.get<double>();
+                const bool regressed = after > before;
+                regressions += regressed;
+
+                printf("  %s %s/%s/%s: %.0f -> %.0f\n", regressed ? "REGRESSION" : "ok        ",
+                    suite.c_str(), scenario.c_str(), name.c_str(), before, after);
+            }
+        }
+    }
+
+    return regressions;
+}
+
+static bool parse_options(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (std::strcmp(arg, "--out") == 0 && has_value) {
+            options.output = argv[++i];
+        }
+        else if (std::strcmp(arg, "--compare") == 0 && has_value) {
+            options.compare = argv[++i];
+        }
+        else if (std::strcmp(arg, "--iterations") == 0 && has_value) {
+            options.iterations = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(arg, "--threshold") == 0 && has_value) {
+            options.threshold = std::atof(argv[++i]);
+        }
+        else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        fprintf(stderr, "usage: %s [--out FILE] [--compare BASELINE] [--iterations N] [--threshold FRACTION]\n", argv[0]);
+        return 1;
+    }
+
+    nlohmann::json results;
+    results["version"] = RESULT_FORMAT_VERSION;
+    results["seed"] = BENCH_SEED;
+    results["iterations"] = options.iterations;
+
+    for (const Scenario& scenario : make_scenarios()) {
+        const nlohmann::json summary = summarize(bench_generation(scenario, options.iterations));
+        print_summary("generation", scenario.name, summary);
+        results["suites"]["generation"][scenario.name] = summary;
+    }
+
+    for (const Scenario& scenario : make_scenarios()) {
+        const nlohmann::json summary = summarize(bench_meshing(scenario, options.iterations));
+        print_summary("meshing", scenario.name, summary);
+        results["suites"]["meshing"][scenario.name] = summary;
+    }
+
+    {
+        const nlohmann::json summary = summarize(bench_culling(options.iterations));
+        print_summary("culling", "view-box", summary);
+        results["suites"]["culling"]["view-box"] = summary;
+    }
+
+    {
+        std::ofstream stream(options.output);
+        if (!stream) {
+            fprintf(stderr, "Could not write '%s'.\n", options.output.c_str());
+            return 1;
+        }
+        stream << results.dump(2) << "\n";
+    }
+    printf("Results written to %s\n", options.output.c_str());
+
+    if (!options.compare.empty()) {
+        std::ifstream stream(options.compare);
+        if (!stream) {
+            fprintf(stderr, "Could not read baseline '%s'.\n", options.compare.c_str());
+            return 1;
+        }
+
+        nlohmann::json baseline = nlohmann::json::parse(stream, nullptr, false);
+        if (baseline.is_discarded() || !baseline.contains("suites")) {
+            fprintf(stderr, "Baseline '%s' is not a diggy_bench result.\n", options.compare.c_str());
+            return 1;
+        }
+
+        printf("Comparing against %s (threshold %.0f%%):\n", options.compare.c_str(), options.threshold * 100.0);
+        if (int regressions = compare_results(baseline, results, options.threshold); regressions > 0) {
+            printf("%d stage(s) regressed.\n", regressions);
+            return 3;
+        }
+        printf("No regressions.\n");
+    }
+
+    return 0;
+}
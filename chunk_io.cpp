@@ -0,0 +1,267 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#include "chunk_io.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+namespace chunk_io {
+
+    static constexpr char MAGIC[4] = {'D', 'G', 'C', 'K'};
+    static constexpr const char* EXTENSION = ".chunk";
+    static constexpr const char* PARTIAL_EXTENSION = ".chunk.tmp";
+    static constexpr const char* WORLD_INFO_NAME = "world.info";
+
+    struct FileHeader {
+        char magic[4];
+        uint16_t version;
+        uint16_t reserved;
+        int32_t x, y, z;
+        uint32_t run_count;
+        uint32_t checksum;
+    };
+
+    struct Run {
+        uint16_t length;
+        uint16_t material;
+    };
+
+    static uint32_t checksum(const Run* runs, size_t count) noexcept {
+        uint32_t h = 0x811c9dc5u;
+        const auto* bytes = reinterpret_cast<const unsigned char*>(runs);
+        for (size_t i = 0; i < count * sizeof(Run); i++) {
+            h ^= bytes[i];
+            h *= 0x01000193u;
+        }
+        return h;
+    }
+
+    std::string chunk_path(const std::string& directory, ChunkCoord coord) {
+        return directory + "/" + std::to_string(coord.x) + "." + std::to_string(coord.y) + "."
+            + std::to_string(coord.z) + EXTENSION;
+    }
+
+    ChunkIOError write_chunk(const std::string& directory, ChunkCoord coord, const Chunk& chunk) noexcept {
+        std::vector<Run> runs;
+        runs.reserve(64);
+
+        Material current = chunk.voxels[0];
+        uint16_t length = 0;
+        for (size_t i = 0; i < CHUNK_VOLUME; i++) {
+            if (chunk.voxels[i] != current || length == UINT16_MAX) {
+                runs.push_back({length, static_cast<uint16_t>(current)});
+                current = chunk.voxels[i];
+                length = 0;
+            }
+            length++;
+        }
+        runs.push_back({length, static_cast<uint16_t>(current)});
+
+        FileHeader header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = FORMAT_VERSION;
+        header.x = coord.x;
+        header.y = coord.y;
+        header.z = coord.z;
+        header.run_count = static_cast<uint32_t>(runs.size());
+        header.checksum = checksum(runs.data(), runs.size());
+
+        const std::string final_path = chunk_path(directory, coord);
+        const std::string partial_path = final_path + ".tmp";
+
+        {
+            std::ofstream stream(partial_path, std::ios::binary | std::ios::trunc);
+            if (!stream) {
+                return ChunkIOError::CouldNotOpen;
+            }
+
+            stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            stream.write(reinterpret_cast<const char*>(runs.data()), static_cast<std::streamsize>(runs.size() * sizeof(Run)));
+
+            if (!stream) {
+                return ChunkIOError::WriteFailed;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(partial_path, final_path, ec);
+        if (ec) {
+            std::filesystem::remove(partial_path, ec);
+            return ChunkIOError::WriteFailed;
+        }
+
+        return ChunkIOError::None;
+    }
+
+    static ChunkIOError read_header(std::ifstream& stream, ChunkCoord coord, FileHeader& header) noexcept {
+        stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!stream) {
+            return ChunkIOError::BadHeader;
+        }
+
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != FORMAT_VERSION) {
+            return ChunkIOError::BadHeader;
+        }
+        if (header.x != coord.x || header.y != coord.y || header.z != coord.z) {
+            return ChunkIOError::BadHeader;
+        }
+        if (header.run_count == 0 || header.run_count > CHUNK_VOLUME) {
+            return ChunkIOError::Corrupt;
+        }
+
+        return ChunkIOError::None;
+    }
+
+    ChunkIOError read_chunk(const std::string& directory, ChunkCoord coord, Chunk& out) noexcept {
+        std::ifstream stream(chunk_path(directory, coord), std::ios::binary);
+        if (!stream) {
+            return ChunkIOError::CouldNotOpen;
+        }
+
+        FileHeader header;
+        if (ChunkIOError err = read_header(stream, coord, header); err != ChunkIOError::None) {
+            return err;
+        }
+
+        std::vector<Run> runs(header.run_count);
+        stream.read(reinterpret_cast<char*>(runs.data()), static_cast<std::streamsize>(runs.size() * sizeof(Run)));
+        if (!stream || checksum(runs.data(), runs.size()) != header.checksum) {
+            return ChunkIOError::Corrupt;
+        }
+
+        size_t cursor = 0;
+        for (const Run& run : runs) {
+            if (run.material >= static_cast<uint16_t>(Material::INVALID) || cursor + run.length > CHUNK_VOLUME) {
+                return ChunkIOError::Corrupt;
+            }
+            std::fill_n(out.voxels + cursor, run.length, static_cast<Material>(run.material));
+            cursor += run.length;
+        }
+
+        return cursor == CHUNK_VOLUME ? ChunkIOError::None : ChunkIOError::Corrupt;
+    }
+
+    bool chunk_exists(const std::string& directory, ChunkCoord coord) noexcept {
+        std::ifstream stream(chunk_path(directory, coord), std::ios::binary);
+        if (!stream) {
+            return false;
+        }
+
+        FileHeader header;
+        return read_header(stream, coord, header) == ChunkIOError::None;
+    }
+
+    // Calls visit(name, field) for every field world.info stores.
+    template <typename Info, typename Visit>
+    static void visit_world_info(Info& info, Visit&& visit) {
+        visit("seed", info.seed);
+        visit("erosion", info.erosion);
+
+        auto& settings = info.erosion_settings;
+        visit("erosion.droplets_per_tile", settings.droplets_per_tile);
+        visit("erosion.max_lifetime", settings.max_lifetime);
+        visit("erosion.brush_radius", settings.brush_radius);
+        visit("erosion.inertia", settings.inertia);
+        visit("erosion.sediment_capacity", settings.sediment_capacity);
+        visit("erosion.min_sediment_capacity", settings.min_sediment_capacity);
+        visit("erosion.deposit_speed", settings.deposit_speed);
+        visit("erosion.erode_speed", settings.erode_speed);
+        visit("erosion.evaporate_speed", settings.evaporate_speed);
+        visit("erosion.gravity", settings.gravity);
+    }
+
+    ChunkIOError write_world_info(const std::string& directory, const WorldInfo& info) noexcept {
+        const std::string final_path = directory + "/" + WORLD_INFO_NAME;
+        const std::string partial_path = final_path + ".tmp";
+
+        {
+            std::ofstream stream(partial_path, std::ios::trunc);
+            if (!stream) {
+                return ChunkIOError::CouldNotOpen;
+            }
+
+            // Floats are written with enough digits to read back exactly.
+            stream.precision(std::numeric_limits<float>::max_digits10);
+            stream << "version " << WORLD_INFO_VERSION << '\n';
+            visit_world_info(info, [&](const char* name, const auto& value) {
+                stream << name << ' ' << +value << '\n';
+            });
+
+            if (!stream) {
+                return ChunkIOError::WriteFailed;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(partial_path, final_path, ec);
+        if (ec) {
+            std::filesystem::remove(partial_path, ec);
+            return ChunkIOError::WriteFailed;
+        }
+
+        return ChunkIOError::None;
+    }
+
+    ChunkIOError read_world_info(const std::string& directory, WorldInfo& out) noexcept {
+        std::ifstream stream(directory + "/" + WORLD_INFO_NAME);
+        if (!stream) {
+            return ChunkIOError::CouldNotOpen;
+        }
+
+        std::string key;
+        uint16_t version = 0;
+        if (!(stream >> key >> version) || key != "version" || version != WORLD_INFO_VERSION) {
+            return ChunkIOError::BadHeader;
+        }
+
+        // Every field has to be there, so a file from an older version
+        // can't pass for one with defaults.
+        WorldInfo info;
+        size_t fields = 0, found = 0;
+        visit_world_info(info, [&](const char*, const auto&) { fields++; });
+
+        while (stream >> key) {
+            bool known = false, parsed = false;
+            visit_world_info(info, [&](const char* name, auto& value) {
+                if (known || key != name) return;
+                known = true;
+                parsed = static_cast<bool>(stream >> value);
+            });
+            if (!known || !parsed) {
+                return ChunkIOError::Corrupt;
+            }
+            found++;
+        }
+
+        if (found != fields) {
+            return ChunkIOError::Corrupt;
+        }
+        out = info;
+        return ChunkIOError::None;
+    }
+
+    size_t remove_partial_files(const std::string& directory) noexcept {
+        std::error_code ec;
+        size_t removed = 0;
+
+        for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+            const std::string name = entry.path().filename().string();
+            const size_t suffix = std::strlen(PARTIAL_EXTENSION);
+
+            if (name.size() > suffix && name.compare(name.size() - suffix, suffix, PARTIAL_EXTENSION) == 0) {
+                if (std::filesystem::remove(entry.path(), ec)) {
+                    removed++;
+                }
+            }
+        }
+
+        return removed;
+    }
+
+}
@@ -0,0 +1,7 @@
+#version 330 core
+out vec4 FragColor;
+
+// Occlusion query boxes are drawn with colour writes off.
+void main(){
+    FragColor = vec4(1.0);
+}
@@ -0,0 +1,14 @@
+#version 330 core
+
+layout(location = 0) in vec3 v_Position;
+
+// See chunk_vert.glsl.
+layout(std140) uniform Camera {
+    mat4 u_Projection;
+    mat4 u_View;
+    mat4 u_ViewProjection;
+};
+
+void main(){
+    gl_Position = u_ViewProjection * vec4(v_Position, 1.0);
+}
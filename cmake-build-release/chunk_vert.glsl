@@ -0,0 +1,53 @@
+#version 330 core
+
+// PackedVertex, see mesh.h:
+// x: x:6 y:6 z:6 face:3 ao:2 light:4
+// y: atlas tile:16
+layout(location = 0) in uvec2 v_Packed;
+// Chunk offset (xyz) and voxel scale (w) of batched draws, (0, 0, 0, 1)
+// otherwise; see MESH_ORIGIN_ATTRIBUTE.
+layout(location = 5) in vec4 v_Origin;
+
+out vec3 f_Color;
+out vec2 f_Uv;
+flat out float f_Tile;
+
+// Shared by every program, see CameraBlock in renderer.h.
+layout(std140) uniform Camera {
+    mat4 u_Projection;
+    mat4 u_View;
+    mat4 u_ViewProjection;
+};
+
+// Streamed per draw, see DrawBlock in renderer.h.
+layout(std140) uniform Draw {
+    mat4 u_Model;
+};
+
+void main(){
+    uint bits = v_Packed.x;
+    vec3 position = vec3(float(bits & 63u), float((bits >> 6) & 63u), float((bits >> 12) & 63u));
+    uint face = (bits >> 18) & 7u;
+    // AO level 0..3 to the same brightness as ao_brightness in mesher.cpp.
+    float ao = 0.4 + 0.2 * float((bits >> 21) & 3u);
+    float light = float((bits >> 23) & 15u) / 15.0;
+
+    gl_Position = u_ViewProjection * u_Model * vec4(v_Origin.xyz + position * v_Origin.w, 1.0);
+
+    // Same tile-local UVs as emit_face in mesher.cpp, by FaceDirection.
+    if (face < 2u) {
+        f_Uv = position.zy;
+    }
+    else if (face == 2u) {
+        f_Uv = position.xz;
+    }
+    else if (face == 3u) {
+        f_Uv = position.zx;
+    }
+    else {
+        f_Uv = position.xy;
+    }
+
+    f_Color = vec3(ao * light);
+    f_Tile = float(v_Packed.y & 0xFFFFu);
+}
@@ -3,9 +3,25 @@ out vec4 FragColor;
 
 in vec3 f_Color;
 in vec2 f_Uv;
+flat in float f_Tile;
 
 uniform sampler2D texture_atlas;
 
+const float ATLAS_TILES_PER_ROW = 32.0;
+
 void main(){
-    FragColor = vec4(texture(texture_atlas, f_Uv).rgb, 1.0); // * vec4(f_Color, 1.0);
+    if (f_Tile < 0.0) {
+        FragColor = vec4(texture(texture_atlas, f_Uv).rgb, 1.0); // * vec4(f_Color, 1.0);
+        return;
+    }
+
+    // Repeat the tile across merged quads; gradients come from the unwrapped
+    // UV so the fract() seam doesn't pick the smallest mip.
+    float step = 1.0 / ATLAS_TILES_PER_ROW;
+    vec2 cell = vec2(mod(f_Tile, ATLAS_TILES_PER_ROW), floor(f_Tile / ATLAS_TILES_PER_ROW));
+    vec2 local = fract(f_Uv);
+    vec2 uv = vec2((cell.x + local.x) * step, 1.0 - (cell.y + 1.0 - local.y) * step);
+
+    // f_Color carries the baked ambient occlusion.
+    FragColor = vec4(textureGrad(texture_atlas, uv, dFdx(f_Uv) * step, dFdy(f_Uv) * step).rgb * f_Color, 1.0);
 }
\ No newline at end of file
@@ -4,18 +4,31 @@ layout(location = 0) in vec3 v_Position;
 layout(location = 1) in vec3 v_Normal;
 layout(location = 2) in vec3 v_Color;
 layout(location = 3) in vec2 v_Uv;
+layout(location = 4) in float v_Tile;
+// See chunk_vert.glsl.
+layout(location = 5) in vec4 v_Origin;
 
 out vec3 f_Color;
 out vec2 f_Uv;
+flat out float f_Tile;
 
-uniform mat4 u_Projection;
-uniform mat4 u_View;
-uniform mat4 u_Model;
+// Shared by every program, see CameraBlock in renderer.h.
+layout(std140) uniform Camera {
+    mat4 u_Projection;
+    mat4 u_View;
+    mat4 u_ViewProjection;
+};
+
+// Streamed per draw, see DrawBlock in renderer.h.
+layout(std140) uniform Draw {
+    mat4 u_Model;
+};
 
 void main(){
-    gl_Position = u_Projection * u_View * u_Model * vec4(v_Position, 1.0);
+    gl_Position = u_ViewProjection * u_Model * vec4(v_Origin.xyz + v_Position * v_Origin.w, 1.0);
 
     f_Color = v_Color;
     f_Uv = v_Uv;
+    f_Tile = v_Tile;
 }
 
@@ -0,0 +1,346 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#include "erosion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+#include "thread_pool.h"
+#include "worldgen.h"
+
+static constexpr char TILE_MAGIC[4] = {'D', 'G', 'E', 'R'};
+static constexpr uint32_t TILE_VERSION = 1;
+
+struct TileFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t seed;
+    int32_t tile_x, tile_z;
+    int32_t span;
+};
+
+struct HeightAndGradient {
+    float height;
+    float gradient_x;
+    float gradient_z;
+};
+
+static HeightAndGradient sample_map(const std::vector<float>& map, float x, float z) noexcept {
+    constexpr int S = TerrainErosion::TILE_SPAN;
+
+    const int cx = static_cast<int>(x);
+    const int cz = static_cast<int>(z);
+    const float u = x - cx;
+    const float v = z - cz;
+
+    const size_t i = cx + cz * S;
+    const float h00 = map[i];
+    const float h10 = map[i + 1];
+    const float h01 = map[i + S];
+    const float h11 = map[i + S + 1];
+
+    return {
+        h00 * (1 - u) * (1 - v) + h10 * u * (1 - v) + h01 * (1 - u) * v + h11 * u * v,
+        (h10 - h00) * (1 - v) + (h11 - h01) * v,
+        (h01 - h00) * (1 - u) + (h11 - h10) * u,
+    };
+}
+
+TerrainErosion::TerrainErosion(const WorldGenerator& generator, ErosionSettings settings, std::string cache_directory)
+    : m_Generator{generator}, m_Settings{settings}, m_CacheDirectory{std::move(cache_directory)} {
+    if (!m_CacheDirectory.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(m_CacheDirectory, ec);
+    }
+}
+
+TerrainErosion::~TerrainErosion() {
+
+}
+
+int32_t TerrainErosion::tile_of(int32_t world) noexcept {
+    return world >= 0 ? world / TILE_SIZE : -((-world - 1) / TILE_SIZE) - 1;
+}
+
+size_t TerrainErosion::tiles_cached() noexcept {
+    std::lock_guard lock{m_Mutex};
+    return m_Tiles.size();
+}
+
+TerrainErosion::Tile& TerrainErosion::get_tile(int32_t tile_x, int32_t tile_z) {
+    Tile* tile;
+    {
+        std::lock_guard lock{m_Mutex};
+        auto& slot = m_Tiles[ChunkCoord{tile_x, 0, tile_z}];
+        if (!slot) {
+            slot = std::make_unique<Tile>();
+        }
+        tile = slot.get();
+    }
+
+    // Other threads asking for the same tile block here instead of eroding it twice.
+    std::call_once(tile->ready, [&] {
+        if (load_tile(tile_x, tile_z, tile->offsets)) {
+            return;
+        }
+        erode_tile(tile_x, tile_z, tile->offsets);
+        save_tile(tile_x, tile_z, tile->offsets);
+    });
+
+    return *tile;
+}
+
+// Cross-fades the offsets of the tiles a column overlaps; tile(x, z) gives
+// the ready offsets of a tile.
+template <typename TileOffsets>
+static float blend_offset(int32_t world_x, int32_t world_z, TileOffsets&& tile) {
+    constexpr int TILE_SIZE = TerrainErosion::TILE_SIZE;
+    constexpr int TILE_BLEND = TerrainErosion::TILE_BLEND;
+    constexpr int TILE_BORDER = TerrainErosion::TILE_BORDER;
+    constexpr int TILE_SPAN = TerrainErosion::TILE_SPAN;
+
+    const int32_t tile_x = TerrainErosion::tile_of(world_x);
+    const int32_t tile_z = TerrainErosion::tile_of(world_z);
+    const int local_x = world_x - tile_x * TILE_SIZE;
+    const int local_z = world_z - tile_z * TILE_SIZE;
+
+    // Weight of the owning tile along one axis, and which neighbour gets the rest.
+    auto blend = [](int local, int& neighbour) {
+        if (local < TILE_BLEND) {
+            neighbour = -1;
+            return 0.5f + 0.5f * (local + 0.5f) / TILE_BLEND;
+        }
+        if (local >= TILE_SIZE - TILE_BLEND) {
+            neighbour = 1;
+            return 0.5f + 0.5f * (TILE_SIZE - local - 0.5f) / TILE_BLEND;
+        }
+        neighbour = 0;
+        return 1.0f;
+    };
+
+    int neighbour_x, neighbour_z;
+    const float own_x = blend(local_x, neighbour_x);
+    const float own_z = blend(local_z, neighbour_z);
+
+    float result = 0.0f;
+    for (int dz = 0; dz <= (neighbour_z != 0); dz++) {
+        for (int dx = 0; dx <= (neighbour_x != 0); dx++) {
+            const int ox = dx ? neighbour_x : 0;
+            const int oz = dz ? neighbour_z : 0;
+            const float weight = (dx ? 1.0f - own_x : own_x) * (dz ? 1.0f - own_z : own_z);
+
+            const std::vector<float>& offsets = tile(tile_x + ox, tile_z + oz);
+            const int sx = local_x - ox * TILE_SIZE + TILE_BORDER;
+            const int sz = local_z - oz * TILE_SIZE + TILE_BORDER;
+            result += offsets[sx + sz * TILE_SPAN] * weight;
+        }
+    }
+
+    return result;
+}
+
+float TerrainErosion::height_offset(int32_t world_x, int32_t world_z) {
+    return blend_offset(world_x, world_z, [this](int32_t tile_x, int32_t tile_z) -> const std::vector<float>& {
+        return get_tile(tile_x, tile_z).offsets;
+    });
+}
+
+void TerrainErosion::height_offsets(int32_t world_x, int32_t world_z, int width, int depth, float* out) {
+    // Every tile a column of the area may blend with, each looked up (under
+    // the lock) the first time it is needed rather than once per sample.
+    const int32_t first_x = tile_of(world_x) - 1;
+    const int32_t first_z = tile_of(world_z) - 1;
+    const int tiles_x = tile_of(world_x + width - 1) + 2 - first_x;
+    const int tiles_z = tile_of(world_z + depth - 1) + 2 - first_z;
+    std::vector<const Tile*> tiles(static_cast<size_t>(tiles_x * tiles_z), nullptr);
+
+    auto tile = [&](int32_t tile_x, int32_t tile_z) -> const std::vector<float>& {
+        const Tile*& found = tiles[(tile_x - first_x) + (tile_z - first_z) * tiles_x];
+        if (!found) {
+            found = &get_tile(tile_x, tile_z);
+        }
+        return found->offsets;
+    };
+
+    for (int z = 0; z < depth; z++) {
+        for (int x = 0; x < width; x++) {
+            out[x + z * width] = blend_offset(world_x + x, world_z + z, tile);
+        }
+    }
+}
+
+void TerrainErosion::prepare(int32_t min_tile_x, int32_t min_tile_z, int32_t max_tile_x, int32_t max_tile_z, ThreadPool& pool) {
+    const size_t width = static_cast<size_t>(max_tile_x - min_tile_x + 1);
+    const size_t depth = static_cast<size_t>(max_tile_z - min_tile_z + 1);
+
+    pool.parallel_for(width * depth, [&](size_t i) {
+        get_tile(min_tile_x + static_cast<int32_t>(i % width), min_tile_z + static_cast<int32_t>(i / width));
+    });
+}
+
+void TerrainErosion::erode_tile(int32_t tile_x, int32_t tile_z, std::vector<float>& offsets) const {
+    constexpr int S = TILE_SPAN;
+    const ErosionSettings& cfg = m_Settings;
+
+    const int32_t origin_x = tile_x * TILE_SIZE - TILE_BORDER;
+    const int32_t origin_z = tile_z * TILE_SIZE - TILE_BORDER;
+
+    std::vector<float> map(S * S);
+    for (int z = 0; z < S; z++) {
+        for (int x = 0; x < S; x++) {
+            map[x + z * S] = m_Generator.raw_height(origin_x + x, origin_z + z);
+        }
+    }
+    offsets = map;
+
+    // Erosion is spread over a small disc so droplets carve channels rather than pits.
+    std::vector<int> brush_offsets;
+    std::vector<float> brush_weights;
+    {
+        const int r = cfg.brush_radius;
+        float total = 0.0f;
+        for (int dz = -r; dz <= r; dz++) {
+            for (int dx = -r; dx <= r; dx++) {
+                const float weight = static_cast<float>(r) - std::sqrt(static_cast<float>(dx * dx + dz * dz));
+                if (weight <= 0.0f) continue;
+                brush_offsets.push_back(dx + dz * S);
+                brush_weights.push_back(weight);
+                total += weight;
+            }
+        }
+        for (float& weight : brush_weights) weight /= total;
+    }
+
+    // Seeded per tile so results do not depend on which thread erodes it.
+    std::minstd_rand rng{m_Generator.seed() ^ (static_cast<uint32_t>(tile_x) * 0x9E3779B1u)
+        ^ (static_cast<uint32_t>(tile_z) * 0x85EBCA77u) ^ 0x5bd1e995u};
+    std::uniform_real_distribution<float> spawn{0.0f, static_cast<float>(S - 1)};
+
+    const int r = cfg.brush_radius;
+    for (int droplet = 0; droplet < cfg.droplets_per_tile; droplet++) {
+        float x = spawn(rng);
+        float z = spawn(rng);
+        float dir_x = 0.0f, dir_z = 0.0f;
+        float speed = 1.0f;
+        float water = 1.0f;
+        float sediment = 0.0f;
+
+        for (int step = 0; step < cfg.max_lifetime; step++) {
+            const int cell_x = static_cast<int>(x);
+            const int cell_z = static_cast<int>(z);
+            const float u = x - cell_x;
+            const float v = z - cell_z;
+            const HeightAndGradient here = sample_map(map, x, z);
+
+            dir_x = dir_x * cfg.inertia - here.gradient_x * (1.0f - cfg.inertia);
+            dir_z = dir_z * cfg.inertia - here.gradient_z * (1.0f - cfg.inertia);
+            const float length = std::sqrt(dir_x * dir_x + dir_z * dir_z);
+            if (length <= 1e-6f) break;
+            dir_x /= length;
+            dir_z /= length;
+
+            x += dir_x;
+            z += dir_z;
+            if (x < 0.0f || z < 0.0f || x >= S - 1 || z >= S - 1) break;
+
+            const float delta_height = sample_map(map, x, z).height - here.height;
+            const float capacity = std::max(-delta_height * speed * water * cfg.sediment_capacity, cfg.min_sediment_capacity);
+            const size_t cell = cell_x + cell_z * S;
+
+            if (sediment > capacity || delta_height > 0.0f) {
+                // Uphill: fill the pit behind us. Otherwise drop the excess.
+                const float amount = delta_height > 0.0f ? std::min(delta_height, sediment) : (sediment - capacity) * cfg.deposit_speed;
+                sediment -= amount;
+
+                map[cell] += amount * (1 - u) * (1 - v);
+                map[cell + 1] += amount * u * (1 - v);
+                map[cell + S] += amount * (1 - u) * v;
+                map[cell + S + 1] += amount * u * v;
+            }
+            else {
+                const float amount = std::min((capacity - sediment) * cfg.erode_speed, -delta_height);
+                const bool brush_fits = cell_x >= r && cell_z >= r && cell_x < S - r && cell_z < S - r;
+
+                if (brush_fits) {
+                    for (size_t b = 0; b < brush_offsets.size(); b++) {
+                        const float removed = amount * brush_weights[b];
+                        map[cell + brush_offsets[b]] -= removed;
+                        sediment += removed;
+                    }
+                }
+                else {
+                    map[cell] -= amount;
+                    sediment += amount;
+                }
+            }
+
+            speed = std::sqrt(std::max(0.0f, speed * speed - delta_height * cfg.gravity));
+            water *= 1.0f - cfg.evaporate_speed;
+        }
+    }
+
+    for (size_t i = 0; i < map.size(); i++) {
+        offsets[i] = map[i] - offsets[i];
+    }
+}
+
+bool TerrainErosion::load_tile(int32_t tile_x, int32_t tile_z, std::vector<float>& offsets) const noexcept {
+    if (m_CacheDirectory.empty()) {
+        return false;
+    }
+
+    const std::string path = m_CacheDirectory + "/" + std::to_string(tile_x) + "." + std::to_string(tile_z) + ".tile";
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        return false;
+    }
+
+    TileFileHeader header;
+    stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!stream || std::memcmp(header.magic, TILE_MAGIC, sizeof(TILE_MAGIC)) != 0 || header.version != TILE_VERSION
+        || header.seed != m_Generator.seed() || header.tile_x != tile_x || header.tile_z != tile_z || header.span != TILE_SPAN) {
+        return false;
+    }
+
+    offsets.resize(TILE_SPAN * TILE_SPAN);
+    stream.read(reinterpret_cast<char*>(offsets.data()), static_cast<std::streamsize>(offsets.size() * sizeof(float)));
+    return static_cast<bool>(stream);
+}
+
+void TerrainErosion::save_tile(int32_t tile_x, int32_t tile_z, const std::vector<float>& offsets) const noexcept {
+    if (m_CacheDirectory.empty()) {
+        return;
+    }
+
+    const std::string path = m_CacheDirectory + "/" + std::to_string(tile_x) + "." + std::to_string(tile_z) + ".tile";
+    const std::string partial_path = path + ".tmp";
+
+    TileFileHeader header{};
+    std::memcpy(header.magic, TILE_MAGIC, sizeof(TILE_MAGIC));
+    header.version = TILE_VERSION;
+    header.seed = m_Generator.seed();
+    header.tile_x = tile_x;
+    header.tile_z = tile_z;
+    header.span = TILE_SPAN;
+
+    {
+        std::ofstream stream(partial_path, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            return;
+        }
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        stream.write(reinterpret_cast<const char*>(offsets.data()), static_cast<std::streamsize>(offsets.size() * sizeof(float)));
+        if (!stream) {
+            return;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(partial_path, path, ec);
+}
@@ -0,0 +1,145 @@
+//
+// Created by ctlf on 10/18/26.
+//
+#include "frustum.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+Frustum extract_frustum(const mat4& view_projection) noexcept {
+    // glm is column-major: row i is m[0][i], m[1][i], m[2][i], m[3][i].
+    const mat4& m = view_projection;
+    const vec4 rows[4] {
+        {m[0][0], m[1][0], m[2][0], m[3][0]},
+        {m[0][1], m[1][1], m[2][1], m[3][1]},
+        {m[0][2], m[1][2], m[2][2], m[3][2]},
+        {m[0][3], m[1][3], m[2][3], m[3][3]},
+    };
+
+    // Left, right, bottom, top, near, far; GL clip space, so -w <= z <= w.
+    Frustum frustum{{
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2],
+    }};
+
+    for (vec4& plane : frustum.planes) {
+        const float length = glm::length(vec3{plane});
+        if (length > 0.0f) plane /= length;
+    }
+    return frustum;
+}
+
+void AabbList::clear() noexcept {
+    m_Count = 0;
+    m_CenterX.clear();
+    m_CenterY.clear();
+    m_CenterZ.clear();
+    m_ExtentX.clear();
+    m_ExtentY.clear();
+    m_ExtentZ.clear();
+}
+
+void AabbList::add(vec3 min, vec3 max) {
+    // Grows a whole batch at a time; the padding boxes are points at the
+    // origin whose results are never read.
+    if (m_Count == m_CenterX.size()) {
+        const size_t padded = m_Count + BATCH;
+        m_CenterX.resize(padded);
+        m_CenterY.resize(padded);
+        m_CenterZ.resize(padded);
+        m_ExtentX.resize(padded);
+        m_ExtentY.resize(padded);
+        m_ExtentZ.resize(padded);
+    }
+
+    const vec3 center = (min + max) * 0.5f;
+    const vec3 extent = (max - min) * 0.5f;
+    m_CenterX[m_Count] = center.x;
+    m_CenterY[m_Count] = center.y;
+    m_CenterZ[m_Count] = center.z;
+    m_ExtentX[m_Count] = extent.x;
+    m_ExtentY[m_Count] = extent.y;
+    m_ExtentZ[m_Count] = extent.z;
+    m_Count++;
+}
+
+// A box is outside once it lies wholly behind one plane, inside when it lies
+// wholly in front of all six. The distance of its center to a plane is
+// compared against its extent projected onto the plane normal.
+void AabbList::cull_scalar(const Frustum& frustum, std::vector<CullResult>& results) const {
+    results.resize(m_Count);
+
+    for (size_t i = 0; i < m_Count; i++) {
+        bool outside = false;
+        bool inside = true;
+
+        for (const vec4& plane : frustum.planes) {
+            const float distance = plane.x * m_CenterX[i] + plane.y * m_CenterY[i] + plane.z * m_CenterZ[i] + plane.w;
+            const float radius = std::abs(plane.x) * m_ExtentX[i] + std::abs(plane.y) * m_ExtentY[i]
+                + std::abs(plane.z) * m_ExtentZ[i];
+
+            outside |= distance + radius < 0.0f;
+            inside &= distance - radius >= 0.0f;
+        }
+
+        results[i] = outside ? CullResult::Outside : inside ? CullResult::Inside : CullResult::Intersecting;
+    }
+}
+
+void AabbList::cull(const Frustum& frustum, std::vector<CullResult>& results) const {
+#ifdef __AVX__
+    results.resize(m_Count);
+
+    __m256 normal_x[FRUSTUM_PLANE_COUNT], normal_y[FRUSTUM_PLANE_COUNT], normal_z[FRUSTUM_PLANE_COUNT];
+    __m256 abs_x[FRUSTUM_PLANE_COUNT], abs_y[FRUSTUM_PLANE_COUNT], abs_z[FRUSTUM_PLANE_COUNT];
+    __m256 distance_w[FRUSTUM_PLANE_COUNT];
+    for (size_t p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+        const vec4& plane = frustum.planes[p];
+        normal_x[p] = _mm256_set1_ps(plane.x);
+        normal_y[p] = _mm256_set1_ps(plane.y);
+        normal_z[p] = _mm256_set1_ps(plane.z);
+        abs_x[p] = _mm256_set1_ps(std::abs(plane.x));
+        abs_y[p] = _mm256_set1_ps(std::abs(plane.y));
+        abs_z[p] = _mm256_set1_ps(std::abs(plane.z));
+        distance_w[p] = _mm256_set1_ps(plane.w);
+    }
+
+    const __m256 zero = _mm256_setzero_ps();
+    for (size_t base = 0; base < m_Count; base += BATCH) {
+        const __m256 center_x = _mm256_loadu_ps(&m_CenterX[base]);
+        const __m256 center_y = _mm256_loadu_ps(&m_CenterY[base]);
+        const __m256 center_z = _mm256_loadu_ps(&m_CenterZ[base]);
+        const __m256 extent_x = _mm256_loadu_ps(&m_ExtentX[base]);
+        const __m256 extent_y = _mm256_loadu_ps(&m_ExtentY[base]);
+        const __m256 extent_z = _mm256_loadu_ps(&m_ExtentZ[base]);
+
+        __m256 outside = zero;
+        __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+        for (size_t p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+            __m256 distance = _mm256_add_ps(_mm256_mul_ps(normal_x[p], center_x), _mm256_mul_ps(normal_y[p], center_y));
+            distance = _mm256_add_ps(_mm256_add_ps(distance, _mm256_mul_ps(normal_z[p], center_z)), distance_w[p]);
+
+            __m256 radius = _mm256_add_ps(_mm256_mul_ps(abs_x[p], extent_x), _mm256_mul_ps(abs_y[p], extent_y));
+            radius = _mm256_add_ps(radius, _mm256_mul_ps(abs_z[p], extent_z));
+
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_sub_ps(distance, radius), zero, _CMP_GE_OQ));
+        }
+
+        const int outside_bits = _mm256_movemask_ps(outside);
+        const int inside_bits = _mm256_movemask_ps(inside);
+        const size_t count = std::min(BATCH, m_Count - base);
+        for (size_t i = 0; i < count; i++) {
+            results[base + i] = outside_bits >> i & 1 ? CullResult::Outside
+                : inside_bits >> i & 1 ? CullResult::Inside : CullResult::Intersecting;
+        }
+    }
+#else
+    cull_scalar(frustum, results);
+#endif
+}
@@ -0,0 +1,203 @@
+//
+// Created by ctlf on 10/18/26.
+//
+#include "gl_state.h"
+
+#include <algorithm>
+#include <iterator>
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+bool GLState::change(uint32_t& current, uint32_t value) noexcept {
+    if (current == value) {
+        m_Elided++;
+        return false;
+    }
+    current = value;
+    m_Issued++;
+    return true;
+}
+
+void GLState::use_program(uint32_t program) noexcept {
+    if (change(m_Program, program)) {
+        glUseProgram(program);
+    }
+}
+
+void GLState::bind_vertex_array(uint32_t vertex_array) noexcept {
+    if (change(m_VertexArray, vertex_array)) {
+        glBindVertexArray(vertex_array);
+        m_Buffers[ElementArrayBuffer] = UNKNOWN;
+    }
+}
+
+void GLState::bind_buffer(GLenum target, uint32_t buffer) noexcept {
+    BufferTarget slot;
+    switch (target) {
+        case GL_ARRAY_BUFFER: slot = ArrayBuffer; break;
+        case GL_ELEMENT_ARRAY_BUFFER: slot = ElementArrayBuffer; break;
+        case GL_COPY_READ_BUFFER: slot = CopyReadBuffer; break;
+        case GL_COPY_WRITE_BUFFER: slot = CopyWriteBuffer; break;
+        case GL_DRAW_INDIRECT_BUFFER: slot = DrawIndirectBuffer; break;
+        case GL_UNIFORM_BUFFER: slot = UniformBuffer; break;
+        default:
+            glBindBuffer(target, buffer);
+            m_Issued++;
+            return;
+    }
+
+    if (change(m_Buffers[slot], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLState::bind_buffer_range(GLenum target, uint32_t index, uint32_t buffer, size_t offset, size_t size) noexcept {
+    if (target == GL_UNIFORM_BUFFER && index < UNIFORM_BINDINGS) {
+        BufferRange& bound = m_UniformRanges[index];
+        if (bound.buffer == buffer && bound.offset == offset && bound.size == size) {
+            m_Elided++;
+            return;
+        }
+        bound = {buffer, offset, size};
+    }
+
+    glBindBufferRange(target, index, buffer, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size));
+    m_Issued++;
+    if (target == GL_UNIFORM_BUFFER) {
+        m_Buffers[UniformBuffer] = buffer;
+    }
+}
+
+void GLState::bind_texture(int unit, uint32_t texture) noexcept {
+    if (unit < 0 || unit >= TEXTURE_UNITS) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        m_ActiveTexture = static_cast<uint32_t>(unit);
+        m_Issued += 2;
+        return;
+    }
+
+    if (m_Textures[unit] == texture) {
+        m_Elided++;
+        return;
+    }
+    if (change(m_ActiveTexture, static_cast<uint32_t>(unit))) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    m_Textures[unit] = texture;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    m_Issued++;
+}
+
+void GLState::set_enabled(GLCapability capability, bool enabled) noexcept {
+    constexpr GLenum CAPABILITIES[] {GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE};
+    static_assert(std::size(CAPABILITIES) == static_cast<size_t>(GLCapability::Count));
+
+    const size_t index = static_cast<size_t>(capability);
+    if (change(m_Capabilities[index], enabled)) {
+        if (enabled) {
+            glEnable(CAPABILITIES[index]);
+        }
+        else {
+            glDisable(CAPABILITIES[index]);
+        }
+    }
+}
+
+void GLState::blend_func(GLenum source, GLenum destination) noexcept {
+    if (m_BlendSource == source && m_BlendDestination == destination) {
+        m_Elided++;
+        return;
+    }
+    m_BlendSource = source;
+    m_BlendDestination = destination;
+    glBlendFunc(source, destination);
+    m_Issued++;
+}
+
+void GLState::depth_func(GLenum func) noexcept {
+    if (change(m_DepthFunc, func)) {
+        glDepthFunc(func);
+    }
+}
+
+void GLState::depth_mask(bool write) noexcept {
+    if (change(m_DepthMask, write)) {
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+}
+
+void GLState::color_mask(bool write) noexcept {
+    if (change(m_ColorMask, write)) {
+        const GLboolean mask = write ? GL_TRUE : GL_FALSE;
+        glColorMask(mask, mask, mask, mask);
+    }
+}
+
+void GLState::viewport(int x, int y, int width, int height) noexcept {
+    const uint32_t viewport[4] {
+        static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+        static_cast<uint32_t>(width), static_cast<uint32_t>(height),
+    };
+    if (std::equal(std::begin(viewport), std::end(viewport), m_Viewport)) {
+        m_Elided++;
+        return;
+    }
+    std::copy(std::begin(viewport), std::end(viewport), m_Viewport);
+    glViewport(x, y, width, height);
+    m_Issued++;
+}
+
+void GLState::forget_program(uint32_t program) noexcept {
+    // A deleted program stays in use until another is, but its name may
+    // come back once it is gone.
+    if (m_Program == program) {
+        m_Program = UNKNOWN;
+    }
+}
+
+void GLState::forget_vertex_array(uint32_t vertex_array) noexcept {
+    if (m_VertexArray == vertex_array) {
+        m_VertexArray = 0;
+        m_Buffers[ElementArrayBuffer] = UNKNOWN;
+    }
+}
+
+void GLState::forget_buffer(uint32_t buffer) noexcept {
+    for (uint32_t& bound : m_Buffers) {
+        if (bound == buffer) {
+            bound = 0;
+        }
+    }
+    for (BufferRange& bound : m_UniformRanges) {
+        if (bound.buffer == buffer) {
+            bound = {0, 0, 0};
+        }
+    }
+}
+
+void GLState::forget_texture(uint32_t texture) noexcept {
+    for (uint32_t& bound : m_Textures) {
+        if (bound == texture) {
+            bound = 0;
+        }
+    }
+}
+
+void GLState::invalidate() noexcept {
+    m_Program = UNKNOWN;
+    m_VertexArray = UNKNOWN;
+    std::fill(std::begin(m_Buffers), std::end(m_Buffers), UNKNOWN);
+    std::fill(std::begin(m_UniformRanges), std::end(m_UniformRanges), BufferRange{UNKNOWN, 0, 0});
+    m_ActiveTexture = UNKNOWN;
+    std::fill(std::begin(m_Textures), std::end(m_Textures), UNKNOWN);
+    std::fill(std::begin(m_Capabilities), std::end(m_Capabilities), UNKNOWN);
+    m_BlendSource = UNKNOWN;
+    m_BlendDestination = UNKNOWN;
+    m_DepthFunc = UNKNOWN;
+    m_DepthMask = UNKNOWN;
+    m_ColorMask = UNKNOWN;
+    std::fill(std::begin(m_Viewport), std::end(m_Viewport), UNKNOWN);
+}
@@ -0,0 +1,50 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#ifndef ARENA_ALLOCATOR_H
+#define ARENA_ALLOCATOR_H
+
+#include <cstdint>
+#include <map>
+
+// Hands out [offset, offset + size) ranges of a fixed capacity, in whatever
+// unit the owner uses. Free blocks are kept by offset, to merge neighbours on
+// free, and by size, for best-fit allocation; both are O(log n).
+class ArenaAllocator {
+public:
+    explicit ArenaAllocator(uint32_t capacity);
+
+    // Returns INVALID_OFFSET when no free block is large enough.
+    uint32_t allocate(uint32_t size) noexcept;
+    // First fit instead: the lowest block that starts below limit. Linear in
+    // the number of free blocks; meant for compaction.
+    uint32_t allocate_lowest(uint32_t size, uint32_t limit) noexcept;
+    void free(uint32_t offset, uint32_t size) noexcept;
+
+    uint32_t capacity() const noexcept { return m_Capacity; }
+    uint32_t free_space() const noexcept { return m_FreeSpace; }
+    uint32_t largest_free_block() const noexcept;
+
+    // Share of the free space outside the largest free block: 0 when it is
+    // all in one piece, approaching 1 as it splinters.
+    float fragmentation() const noexcept;
+
+public:
+    static constexpr uint32_t INVALID_OFFSET = UINT32_MAX;
+
+private:
+    // Takes size from the start of the free block, returning its offset.
+    uint32_t take_from(std::map<uint32_t, uint32_t>::iterator block, uint32_t size);
+    void insert_block(uint32_t offset, uint32_t size);
+    void erase_block(std::map<uint32_t, uint32_t>::iterator block) noexcept;
+
+private:
+    uint32_t m_Capacity;
+    uint32_t m_FreeSpace;
+
+    std::map<uint32_t, uint32_t> m_BlocksByOffset;
+    std::multimap<uint32_t, uint32_t> m_BlocksBySize;
+};
+
+#endif //ARENA_ALLOCATOR_H
@@ -0,0 +1,81 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Voxel data shared by the game and the headless tools. Nothing in here
+// may pull in SDL or OpenGL.
+
+typedef uint16_t block_t;
+
+enum class Material : block_t {
+    Void,
+    Dirt,
+    Stone,
+    Grass,
+    Wood,
+    Iron,
+    Copper,
+    INVALID
+};
+
+constexpr size_t CHUNK_SIZE_X = 32;
+constexpr size_t CHUNK_SIZE_Y = 32;
+constexpr size_t CHUNK_SIZE_Z = 32;
+constexpr size_t CHUNK_VOLUME = CHUNK_SIZE_X * CHUNK_SIZE_Y * CHUNK_SIZE_Z;
+
+// Chunks are meshed and remeshed in 16^3 sections, 2x2x2 per chunk.
+constexpr size_t SECTION_SIZE = 16;
+constexpr size_t SECTIONS_X = CHUNK_SIZE_X / SECTION_SIZE;
+constexpr size_t SECTIONS_Y = CHUNK_SIZE_Y / SECTION_SIZE;
+constexpr size_t SECTIONS_Z = CHUNK_SIZE_Z / SECTION_SIZE;
+constexpr size_t SECTION_COUNT = SECTIONS_X * SECTIONS_Y * SECTIONS_Z;
+constexpr uint32_t ALL_SECTIONS = (1u << SECTION_COUNT) - 1;
+
+constexpr size_t section_index(size_t x, size_t y, size_t z) noexcept {
+    return x / SECTION_SIZE + SECTIONS_X * (z / SECTION_SIZE + SECTIONS_Z * (y / SECTION_SIZE));
+}
+
+struct ChunkCoord {
+    int32_t x, y, z;
+
+    bool operator==(const ChunkCoord& other) const noexcept {
+        return x == other.x && y == other.y && z == other.z;
+    }
+    bool operator!=(const ChunkCoord& other) const noexcept {
+        return !(*this == other);
+    }
+};
+
+struct ChunkCoordHash {
+    size_t operator()(const ChunkCoord& c) const noexcept {
+        uint64_t h = static_cast<uint32_t>(c.x) * 0x9E3779B97F4A7C15ull;
+        h ^= static_cast<uint32_t>(c.y) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+        h ^= static_cast<uint32_t>(c.z) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+        return static_cast<size_t>(h);
+    }
+};
+
+// Voxels are stored in horizontal layers (x fastest, then z, then y) so a
+// run-length pass over the array walks the strata the generator produces.
+struct Chunk {
+    Material voxels[CHUNK_VOLUME];
+
+    static constexpr size_t index(size_t x, size_t y, size_t z) noexcept {
+        return x + CHUNK_SIZE_X * (z + CHUNK_SIZE_Z * y);
+    }
+
+    Material& at(size_t x, size_t y, size_t z) noexcept { return voxels[index(x, y, z)]; }
+    Material at(size_t x, size_t y, size_t z) const noexcept { return voxels[index(x, y, z)]; }
+};
+
+inline bool material_is_solid(Material material) noexcept {
+    return material != Material::Void;
+}
+
+#endif //CHUNK_H
@@ -0,0 +1,69 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#ifndef CHUNK_IO_H
+#define CHUNK_IO_H
+
+#include <string>
+
+#include "chunk.h"
+#include "erosion.h"
+
+// On-disk chunk format, one file per chunk named "<x>.<y>.<z>.chunk":
+//
+//   char[4]  magic "DGCK"
+//   uint16   version
+//   uint16   reserved
+//   int32    x, y, z
+//   uint32   run count
+//   uint32   checksum (FNV-1a over the runs)
+//   { uint16 length, uint16 material } * run count
+//
+// Runs follow Chunk::index order. Files are written to a temporary name and
+// renamed into place, so a chunk file either exists complete or not at all.
+
+// What the chunks of a directory were generated with, kept in
+// DIR/world.info as "key value" lines: version, seed, erosion (0 or 1) and
+// one erosion.<name> line per ErosionSettings field. diggy_worldgen writes
+// it on its first run into a directory and won't add to a world made with
+// anything else; the game generates chunks past the pre-generated box with
+// the same settings.
+struct WorldInfo {
+    uint32_t seed = 0;
+    bool erosion = false;
+    ErosionSettings erosion_settings{};
+
+    friend bool operator==(const WorldInfo&, const WorldInfo&) = default;
+};
+
+enum class ChunkIOError {
+    None = 0,
+    CouldNotOpen,
+    WriteFailed,
+    BadHeader,
+    Corrupt,
+};
+
+namespace chunk_io {
+    constexpr uint16_t FORMAT_VERSION = 1;
+
+    std::string chunk_path(const std::string& directory, ChunkCoord coord);
+
+    ChunkIOError write_chunk(const std::string& directory, ChunkCoord coord, const Chunk& chunk) noexcept;
+    ChunkIOError read_chunk(const std::string& directory, ChunkCoord coord, Chunk& out) noexcept;
+
+    // True when a complete, valid file for the chunk exists.
+    bool chunk_exists(const std::string& directory, ChunkCoord coord) noexcept;
+
+    constexpr uint16_t WORLD_INFO_VERSION = 1;
+
+    ChunkIOError write_world_info(const std::string& directory, const WorldInfo& info) noexcept;
+    // CouldNotOpen when the directory has no world info yet.
+    ChunkIOError read_world_info(const std::string& directory, WorldInfo& out) noexcept;
+
+    // Removes temporaries left behind by an interrupted writer.
+    size_t remove_partial_files(const std::string& directory) noexcept;
+}
+
+#endif //CHUNK_IO_H
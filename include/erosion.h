@@ -0,0 +1,93 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#ifndef EROSION_H
+#define EROSION_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "chunk.h"
+
+class WorldGenerator;
+class ThreadPool;
+
+struct ErosionSettings {
+    int droplets_per_tile = 70000;
+    int max_lifetime = 30;
+    int brush_radius = 2;
+    float inertia = 0.05f;
+    float sediment_capacity = 4.0f;
+    float min_sediment_capacity = 0.01f;
+    float deposit_speed = 0.3f;
+    float erode_speed = 0.3f;
+    float evaporate_speed = 0.01f;
+    float gravity = 4.0f;
+
+    friend bool operator==(const ErosionSettings&, const ErosionSettings&) = default;
+};
+
+// Droplet-based hydraulic erosion over large heightmap tiles. Each tile is
+// simulated on its core plus a border shared with its neighbours; samples
+// near a tile edge are cross-faded between the overlapping tiles so the
+// independent simulations meet without seams.
+//
+// Tiles are eroded on first use (or ahead of time with prepare()) and cached
+// in memory and, when a cache directory is given, on disk. Chunk generation
+// only ever samples the cached offsets.
+class TerrainErosion {
+public:
+    TerrainErosion(const WorldGenerator& generator, ErosionSettings settings = {}, std::string cache_directory = "");
+    TerrainErosion(const TerrainErosion&) = delete;
+    ~TerrainErosion();
+
+    TerrainErosion& operator=(const TerrainErosion&) = delete;
+
+    // Eroded height minus raw height at a world voxel column. Thread-safe.
+    float height_offset(int32_t world_x, int32_t world_z);
+    // height_offset of the width x depth columns from (world_x, world_z),
+    // x fastest, looking each tile up once instead of once per column.
+    void height_offsets(int32_t world_x, int32_t world_z, int width, int depth, float* out);
+
+    // Erodes every tile in the inclusive tile range in parallel.
+    void prepare(int32_t min_tile_x, int32_t min_tile_z, int32_t max_tile_x, int32_t max_tile_z, ThreadPool& pool);
+
+    // Erodes one tile without caching it; used to measure throughput.
+    void erode_tile(int32_t tile_x, int32_t tile_z, std::vector<float>& offsets) const;
+
+    static int32_t tile_of(int32_t world) noexcept;
+
+    size_t tiles_cached() noexcept;
+
+public:
+    static constexpr int TILE_SIZE = 256;
+    static constexpr int TILE_BORDER = 32;
+    static constexpr int TILE_BLEND = 16;
+    static constexpr int TILE_SPAN = TILE_SIZE + 2 * TILE_BORDER;
+
+private:
+    struct Tile {
+        std::once_flag ready;
+        std::vector<float> offsets;
+    };
+
+    Tile& get_tile(int32_t tile_x, int32_t tile_z);
+
+    bool load_tile(int32_t tile_x, int32_t tile_z, std::vector<float>& offsets) const noexcept;
+    void save_tile(int32_t tile_x, int32_t tile_z, const std::vector<float>& offsets) const noexcept;
+
+private:
+    const WorldGenerator& m_Generator;
+    ErosionSettings m_Settings;
+    std::string m_CacheDirectory;
+
+    std::mutex m_Mutex;
+    std::unordered_map<ChunkCoord, std::unique_ptr<Tile>, ChunkCoordHash> m_Tiles;
+};
+
+#endif //EROSION_H
@@ -0,0 +1,54 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "common.h"
+
+#include <cstdint>
+#include <vector>
+
+constexpr size_t FRUSTUM_PLANE_COUNT = 6;
+
+// Planes as (normal, distance) with the normals pointing inwards, so a point p
+// is inside when dot(normal, p) + distance >= 0 for all of them.
+struct Frustum {
+    vec4 planes[FRUSTUM_PLANE_COUNT];
+};
+
+// Gribb/Hartmann: the planes are sums and differences of the matrix rows.
+// Pass projection * view for world-space planes.
+Frustum extract_frustum(const mat4& view_projection) noexcept;
+
+enum class CullResult : uint8_t {
+    Outside,
+    Intersecting,
+    Inside,
+};
+
+// Axis-aligned boxes in structure-of-arrays form, as centers and half
+// extents, padded to whole batches so they can be tested BATCH at a time.
+class AabbList {
+public:
+    void clear() noexcept;
+    void add(vec3 min, vec3 max);
+
+    size_t size() const noexcept { return m_Count; }
+
+    // One result per box, in the order they were added. Uses AVX when the
+    // build enables it (DIGGY_AVX), cull_scalar otherwise.
+    void cull(const Frustum& frustum, std::vector<CullResult>& results) const;
+    void cull_scalar(const Frustum& frustum, std::vector<CullResult>& results) const;
+
+public:
+    static constexpr size_t BATCH = 8;
+
+private:
+    size_t m_Count = 0;
+    std::vector<float> m_CenterX, m_CenterY, m_CenterZ;
+    std::vector<float> m_ExtentX, m_ExtentY, m_ExtentZ;
+};
+
+#endif //FRUSTUM_H
@@ -0,0 +1,112 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Capabilities toggled through GLState::set_enabled.
+enum class GLCapability : uint8_t {
+    DepthTest,
+    Blend,
+    CullFace,
+    Count,
+};
+
+// A shadow copy of the GL state the renderer changes, so setting what is
+// already set never reaches the driver. Everything starts unknown, making
+// the first call of each kind go through. Anything changing this state
+// behind its back (raw GL calls, deleting bound objects) must tell it, or
+// later calls may be dropped wrongly.
+class GLState {
+public:
+    GLState() noexcept { invalidate(); }
+
+    void use_program(uint32_t program) noexcept;
+
+    // The element array binding belongs to the VAO, so it is forgotten on
+    // every VAO change.
+    void bind_vertex_array(uint32_t vertex_array) noexcept;
+    // Other targets than the ones tracked go straight through.
+    void bind_buffer(GLenum target, uint32_t buffer) noexcept;
+    // glBindBufferRange, which binds the buffer to the target as well.
+    // Uniform binding points below UNIFORM_BINDINGS are tracked.
+    void bind_buffer_range(GLenum target, uint32_t index, uint32_t buffer, size_t offset, size_t size) noexcept;
+    // GL_TEXTURE_2D on the unit; glActiveTexture only when the unit changes.
+    void bind_texture(int unit, uint32_t texture) noexcept;
+
+    void set_enabled(GLCapability capability, bool enabled) noexcept;
+    void blend_func(GLenum source, GLenum destination) noexcept;
+    void depth_func(GLenum func) noexcept;
+    void depth_mask(bool write) noexcept;
+    void color_mask(bool write) noexcept;
+    void viewport(int x, int y, int width, int height) noexcept;
+
+    // Deleting a bound object resets its bindings to 0 in GL; these do the
+    // same here. Call them after the glDelete*.
+    void forget_program(uint32_t program) noexcept;
+    void forget_vertex_array(uint32_t vertex_array) noexcept;
+    void forget_buffer(uint32_t buffer) noexcept;
+    void forget_texture(uint32_t texture) noexcept;
+    // Marks everything unknown, after GL state was changed elsewhere.
+    void invalidate() noexcept;
+
+    uint32_t program() const noexcept { return m_Program; }
+
+    // State calls made and dropped since the last reset_counters.
+    size_t issued() const noexcept { return m_Issued; }
+    size_t elided() const noexcept { return m_Elided; }
+    void reset_counters() noexcept { m_Issued = 0; m_Elided = 0; }
+
+public:
+    static constexpr uint32_t UNKNOWN = UINT32_MAX;
+    // Higher units are bound without tracking.
+    static constexpr int TEXTURE_UNITS = 16;
+    static constexpr uint32_t UNIFORM_BINDINGS = 4;
+
+private:
+    enum BufferTarget {
+        ArrayBuffer,
+        ElementArrayBuffer,
+        CopyReadBuffer,
+        CopyWriteBuffer,
+        DrawIndirectBuffer,
+        UniformBuffer,
+        BufferTargetCount,
+    };
+
+    struct BufferRange {
+        uint32_t buffer;
+        size_t offset;
+        size_t size;
+    };
+
+    // Counts the call; true when it has to be made.
+    bool change(uint32_t& current, uint32_t value) noexcept;
+
+private:
+    // All set by invalidate.
+    uint32_t m_Program;
+    uint32_t m_VertexArray;
+    uint32_t m_Buffers[BufferTargetCount];
+    BufferRange m_UniformRanges[UNIFORM_BINDINGS];
+    uint32_t m_ActiveTexture;
+    uint32_t m_Textures[TEXTURE_UNITS];
+    uint32_t m_Capabilities[static_cast<size_t>(GLCapability::Count)];
+    uint32_t m_BlendSource;
+    uint32_t m_BlendDestination;
+    uint32_t m_DepthFunc;
+    uint32_t m_DepthMask;
+    uint32_t m_ColorMask;
+    uint32_t m_Viewport[4];
+
+    size_t m_Issued = 0;
+    size_t m_Elided = 0;
+};
+
+#endif //GL_STATE_H
@@ -13,6 +13,8 @@ enum class ActionButton {
     InteractPrimary,
     InteractSecondary,
     Jump,
+    // Debug: cycles the terrain's OcclusionCulling mode.
+    CycleOcclusion,
     BUTTON_END
 };
 
@@ -0,0 +1,127 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#ifndef MESH_H
+#define MESH_H
+
+#include <vector>
+
+#include "common.h"
+
+// vec3: Position
+// vec3: Normal
+// vec3: ColorBlend
+// vec2: UV
+// float: Tile
+constexpr size_t FLOATS_PER_VERTEX = 12;
+
+constexpr size_t OFFSET_OF_POSITION = 0;
+constexpr size_t OFFSET_OF_NORMAL = 3 * sizeof(float);
+constexpr size_t OFFSET_OF_COLOR = 6 * sizeof(float);
+constexpr size_t OFFSET_OF_UV = 9 * sizeof(float);
+constexpr size_t OFFSET_OF_TILE = 11 * sizeof(float);
+
+// Vertices with an atlas tile carry tile-local UVs that repeat every 1.0, so
+// merged quads tile their texture; NO_ATLAS_TILE means the UV is used as-is.
+constexpr float NO_ATLAS_TILE = -1.0f;
+
+// Chunk vertices in 8 bytes, unpacked by chunk_vert.glsl:
+// uint: x:6 y:6 z:6 (0..32 in chunk-local voxels), face:3 (FaceDirection),
+//       ao:2, light:4
+// uint: atlas tile:16
+// The tile-local UVs follow from the position and face, so they aren't stored.
+struct PackedVertex {
+    uint32_t position_face_shade;
+    uint32_t tile;
+};
+
+static_assert(sizeof(PackedVertex) == 8);
+
+constexpr uint32_t PACKED_POSITION_BITS = 6;
+constexpr uint32_t PACKED_MAX_AO = 3;
+constexpr uint32_t PACKED_MAX_LIGHT = 15;
+
+constexpr PackedVertex pack_vertex(uint32_t x, uint32_t y, uint32_t z, uint32_t face,
+    uint32_t ao, uint32_t light, uint32_t tile) noexcept {
+    return {
+        x | y << 6 | z << 12 | face << 18 | ao << 21 | light << 23,
+        tile,
+    };
+}
+
+enum class VertexLayout {
+    Float,
+    Packed,
+};
+
+// Index pattern of quad q, relative to its first vertex 4 * q.
+constexpr uint32_t QUAD_INDICES[6] {0, 1, 2, 2, 1, 3};
+
+// A run of indices drawn on its own; chunk meshes keep one per FaceDirection
+// so faces pointing away from the camera can be skipped.
+struct IndexRange {
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+constexpr size_t MAX_INDEX_RANGES = 6;
+
+struct MeshBuffer {
+    VertexLayout layout = VertexLayout::Float;
+    std::vector<float> vertices;
+    std::vector<PackedVertex> packed_vertices;
+    std::vector<uint32_t> indices;
+
+    // Quads only: the renderer draws every 4 vertices with its shared quad
+    // index buffer, so indices stays empty. Build with add_quad or
+    // add_packed_quad alone.
+    bool shared_quad_indices = false;
+
+    // Consecutive ranges covering the indices, or none.
+    IndexRange ranges[MAX_INDEX_RANGES];
+    uint32_t range_count = 0;
+
+    size_t vertex_count() const noexcept;
+    // Including the implied indices of shared_quad_indices buffers.
+    size_t index_count() const noexcept;
+};
+
+class MeshBuilder {
+public:
+    MeshBuilder(MeshBuffer& target);
+    ~MeshBuilder();
+
+    void clear() noexcept;
+
+    VertexLayout layout() const noexcept { return m_Buffer.layout; }
+
+    // Everything added between these lands in the next IndexRange.
+    void begin_index_range() noexcept;
+    void end_index_range() noexcept;
+
+    void add_vertex(vec3 position, vec3 normal, vec3 color, vec2 uv, float tile = NO_ATLAS_TILE) noexcept;
+    void add_index(uint32_t index) noexcept;
+
+    void add_triangle(vec3 position0, vec3 position1, vec3 position2,
+                    vec3 color0, vec3 color1, vec3 color2,
+                     vec2 uv0, vec2 uv1, vec2 uv2, vec3 normal) noexcept;
+
+    void add_quad(vec3 position0, vec3 position1, vec3 position2, vec3 position3,
+        vec3 color0, vec3 color1, vec3 color2, vec3 color3,
+        vec2 uv0, vec2 uv1, vec2 uv2, vec2 uv3,
+        vec3 normal, float tile = NO_ATLAS_TILE) noexcept;
+
+    // For VertexLayout::Packed buffers, same winding as add_quad.
+    void add_packed_quad(PackedVertex vertex0, PackedVertex vertex1, PackedVertex vertex2, PackedVertex vertex3) noexcept;
+
+private:
+    // Indices of the last four vertices as a quad, unless they are implied.
+    void add_quad_indices() noexcept;
+
+private:
+    MeshBuffer& m_Buffer;
+    uint32_t m_VertexCount = 0;
+};
+
+#endif //MESH_H
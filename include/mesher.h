@@ -0,0 +1,166 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#ifndef MESHER_H
+#define MESHER_H
+
+#include "chunk.h"
+#include "mesh.h"
+
+enum class FaceDirection {
+    NegX,
+    PosX,
+    NegY,
+    PosY,
+    NegZ,
+    PosZ,
+    DIRECTION_END
+};
+
+constexpr size_t FACE_DIRECTION_COUNT = static_cast<size_t>(FaceDirection::DIRECTION_END);
+
+// texture_pack.png is a 32x32 grid of 16px tiles, numbered as in terrain_pack.json.
+constexpr int ATLAS_TILES_PER_ROW = 32;
+
+struct MaterialData {
+    const char* name;
+    int hardness;
+    vec3 base_color;
+    uint16_t atlas_tile;
+};
+
+const MaterialData& get_material_data(Material material) noexcept;
+
+enum class MeshingMode {
+    Culled,
+    Greedy,
+    Binary,
+};
+
+// A chunk and its six face neighbours, indexed by FaceDirection. Missing
+// neighbours are treated as air, so the border faces towards them are kept.
+struct ChunkNeighbourhood {
+    const Chunk* center = nullptr;
+    const Chunk* neighbours[FACE_DIRECTION_COUNT]{};
+};
+
+// Level-of-detail copy of chunk: every factor^3 block (factor a power of two
+// up to 32) turns solid when at least half of it is, taking the most common
+// material of its topmost non-empty layer so surfaces keep their colour. The
+// blocks are written out at full size, so out meshes like any other chunk.
+void downsample_chunk(const Chunk& chunk, size_t factor, Chunk& out) noexcept;
+// downsample_chunk of only the factor thick slab along one face, which holds
+// the layer a neighbour meshes its border against; the rest of out is left
+// as it was.
+void downsample_chunk_face(const Chunk& chunk, size_t factor, FaceDirection face, Chunk& out) noexcept;
+
+// Stand-in for a chunk's solid voxels when they occlude others: per column of
+// OCCLUDER_BLOCK^2 voxels, the tallest run of layers [from, to) that are solid
+// across the whole column, so its box lies inside the solid. from == to means
+// the column has none.
+constexpr size_t OCCLUDER_BLOCK = 8;
+constexpr size_t OCCLUDER_COLUMNS_X = CHUNK_SIZE_X / OCCLUDER_BLOCK;
+constexpr size_t OCCLUDER_COLUMNS_Z = CHUNK_SIZE_Z / OCCLUDER_BLOCK;
+
+struct ChunkOccluder {
+    uint8_t from[OCCLUDER_COLUMNS_Z][OCCLUDER_COLUMNS_X]{};
+    uint8_t to[OCCLUDER_COLUMNS_Z][OCCLUDER_COLUMNS_X]{};
+};
+
+ChunkOccluder chunk_occluder(const Chunk& chunk) noexcept;
+
+// Which pairs of a chunk's faces can see each other through non-solid voxels:
+// bits a * FACE_DIRECTION_COUNT + b and b * FACE_DIRECTION_COUNT + a, for
+// FaceDirections a and b, are set when one air pocket touches both faces.
+constexpr uint64_t face_connection_bit(size_t a, size_t b) noexcept {
+    return uint64_t{1} << (a * FACE_DIRECTION_COUNT + b);
+}
+constexpr uint64_t ALL_FACE_CONNECTIONS = (uint64_t{1} << FACE_DIRECTION_COUNT * FACE_DIRECTION_COUNT) - 1;
+
+// Positions are emitted in chunk-local voxel units; the chunk's model matrix
+// places and scales them. Holds scratch memory, so keep one per meshing thread
+// and reuse it.
+class ChunkMesher {
+public:
+    // One quad per solid voxel face that touches a non-solid voxel.
+    void mesh_culled(const ChunkNeighbourhood& chunks, MeshBuilder& builder) noexcept;
+
+    // Like mesh_culled, but merges coplanar faces of the same material into
+    // maximal rectangles; their textures repeat per voxel.
+    void mesh_greedy(const ChunkNeighbourhood& chunks, MeshBuilder& builder) noexcept;
+
+    // Same output as mesh_greedy, but visibility comes from 64-bit occupancy
+    // columns (shifts and ANDs) and merging from bit scans over 32-bit rows.
+    // Quads are grouped into one IndexRange per FaceDirection.
+    void mesh_binary(const ChunkNeighbourhood& chunks, MeshBuilder& builder) noexcept;
+
+    // mesh_binary per 16^3 section, into buffers[section_index] for every
+    // section set in section_mask. Positions stay chunk-local.
+    void mesh_sections(const ChunkNeighbourhood& chunks, uint32_t section_mask,
+        MeshBuffer (&buffers)[SECTION_COUNT]) noexcept;
+
+    // Per-vertex ambient occlusion for mesh_binary and mesh_sections, from the
+    // three voxels in front of each face corner; on by default. Corners that
+    // would need a diagonal (edge or corner) neighbour chunk count those
+    // voxels as air.
+    void set_ambient_occlusion(bool enabled) noexcept { m_AmbientOcclusion = enabled; }
+
+    void mesh(const ChunkNeighbourhood& chunks, MeshBuilder& builder, MeshingMode mode) noexcept;
+
+    // Flood fills the chunk's air from its border voxels; see
+    // face_connection_bit. Pockets that touch no face are never visited.
+    uint64_t face_connectivity(const Chunk& chunk) noexcept;
+
+public:
+    static constexpr size_t PADDED_X = CHUNK_SIZE_X + 2;
+    static constexpr size_t PADDED_Y = CHUNK_SIZE_Y + 2;
+    static constexpr size_t PADDED_Z = CHUNK_SIZE_Z + 2;
+
+    // Greedy slices are square; every axis has the same extent.
+    static constexpr size_t SLICE_SIZE = CHUNK_SIZE_X;
+    static_assert(CHUNK_SIZE_Y == SLICE_SIZE && CHUNK_SIZE_Z == SLICE_SIZE);
+    // A padded column must fit one uint64_t, a slice row one uint32_t.
+    static_assert(SLICE_SIZE == 32);
+
+    static constexpr size_t MATERIAL_COUNT = static_cast<size_t>(Material::INVALID);
+    // Bit columns carry a ring one column wide around the chunk.
+    static constexpr size_t COLUMN_STRIDE = SLICE_SIZE + 2;
+    // Four corners at AO level 3 (nothing occluding).
+    static constexpr uint8_t OPEN_AO = 0xFF;
+
+    static constexpr size_t padded_index(size_t x, size_t y, size_t z) noexcept {
+        return x + PADDED_X * (z + PADDED_Z * y);
+    }
+
+private:
+    // Copies the chunk plus a one voxel border taken from its neighbours.
+    void build_padded(const ChunkNeighbourhood& chunks) noexcept;
+    // Fills m_Columns straight from the chunks, without the padded copy.
+    void build_columns(const ChunkNeighbourhood& chunks) noexcept;
+    // Binary greedy meshing of the faces of voxels in [lo, hi) from m_Columns.
+    void emit_binary(const Chunk& center, const size_t lo[3], const size_t hi[3], MeshBuilder& builder) noexcept;
+
+private:
+    Material m_Padded[PADDED_X * PADDED_Y * PADDED_Z];
+
+    // One slice of visible faces for mesh_greedy, Void where there is none.
+    Material m_FaceMask[SLICE_SIZE * SLICE_SIZE];
+
+    // mesh_binary: solid bits of every column along each axis, bits 1..32 from
+    // the chunk and 0/33 from its neighbours, plus a ring of columns from the
+    // face neighbours indexed from -1; and the visible faces of one
+    // direction as [material][slice][u] rows of v bits. Merging consumes every
+    // row bit, so the planes are left zeroed.
+    uint64_t m_Columns[3][COLUMN_STRIDE * COLUMN_STRIDE]{};
+    uint32_t m_Planes[MATERIAL_COUNT][SLICE_SIZE][SLICE_SIZE]{};
+    // 2-bit AO per corner of each visible face of one direction, [slice][u][v].
+    uint8_t m_FaceAO[SLICE_SIZE][SLICE_SIZE][SLICE_SIZE];
+    bool m_AmbientOcclusion = true;
+
+    // face_connectivity: voxels already flooded, and the flood queue.
+    uint64_t m_Flooded[CHUNK_VOLUME / 64];
+    uint16_t m_FloodQueue[CHUNK_VOLUME];
+};
+
+#endif //MESHER_H
@@ -0,0 +1,75 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include "common.h"
+#include "thread_pool.h"
+
+#include <cstdint>
+#include <vector>
+
+// Low resolution software depth buffer for occlusion culling. Each frame the
+// nearest occluders are drawn into it, split over worker threads by screen
+// tile, and a hierarchy of the farthest depth per block is built, so a box
+// is tested with a handful of reads at whichever level it covers. Occluders
+// only write pixels they cover completely, with the farthest depth they reach
+// in them, so the buffer never hides more than they do.
+class OcclusionBuffer {
+public:
+    OcclusionBuffer();
+
+    // Starts a frame, dropping the last frame's occluders.
+    void begin(const mat4& view_projection, vec3 eye) noexcept;
+
+    // The box must lie inside solid geometry. Only its faces towards the eye
+    // are drawn, and faces reaching behind the near plane are dropped.
+    void add_occluder(vec3 min, vec3 max);
+
+    // Rasterises the occluders one tile per job and builds the hierarchy.
+    void rasterize(ThreadPool& pool);
+
+    // Whether the box lies behind the occluders everywhere it covers. Boxes
+    // crossing the near plane never are.
+    bool is_occluded(vec3 min, vec3 max) const noexcept;
+
+    size_t quad_count() const noexcept { return m_Quads.size(); }
+
+public:
+    static constexpr int WIDTH = 256;
+    static constexpr int HEIGHT = 128;
+    // Tiles start at multiples of eight pixels, so rows are filled eight at
+    // a time with AVX (when the build enables it, as for frustum.cpp).
+    static constexpr int TILE_WIDTH = 64;
+    static constexpr int TILE_HEIGHT = 32;
+    static constexpr int TILES_X = WIDTH / TILE_WIDTH;
+    static constexpr int TILES_Y = HEIGHT / TILE_HEIGHT;
+    static constexpr int TILE_COUNT = TILES_X * TILES_Y;
+    // Level n holds the farthest depth of each 2^n x 2^n block of pixels.
+    static constexpr int LEVEL_COUNT = 6;
+
+private:
+    // A box face in pixels, y up, with depth from 0 at the near plane to 1
+    // at the far one; wound counter-clockwise.
+    struct Quad {
+        vec3 corners[4];
+    };
+
+    // Clip space to pixels; false when p is behind the near plane.
+    static bool to_screen(const vec4& clip, vec3& screen) noexcept;
+
+    void rasterize_tile(size_t tile) noexcept;
+    void build_hierarchy() noexcept;
+
+private:
+    mat4 m_ViewProjection{1.0f};
+    vec3 m_Eye{0.0f};
+
+    std::vector<Quad> m_Quads;
+    std::vector<uint32_t> m_Bins[TILE_COUNT];
+    std::vector<float> m_Levels[LEVEL_COUNT];
+};
+
+#endif //OCCLUSION_H
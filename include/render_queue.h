@@ -0,0 +1,89 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "common.h"
+#include "renderer.h"
+
+#include <cstdint>
+#include <vector>
+
+// Translucent draws go after every opaque one.
+enum class RenderLayer : uint8_t {
+    Opaque,
+    Translucent,
+};
+
+// Collects a frame's mesh draws as packets with a 64-bit sort key, radix
+// sorts them and draws them through mesh batches, changing state only
+// between packets that differ. Opaque keys hold, from the top bit down, the
+// layer, shader, texture, vertex array and depth, so packets sharing state
+// stay together and go front to back among themselves for early depth
+// rejection. Translucent keys put the depth, inverted, right after the
+// layer: blending needs them back to front whatever their state.
+class RenderQueue {
+public:
+    explicit RenderQueue(Renderer& renderer) noexcept : m_Renderer{renderer} {}
+
+    // Starts a frame seen through the camera, which execute hands to the
+    // renderer's Camera block. Textures are bound to unit 0.
+    void begin(const mat4& view, const mat4& projection) noexcept;
+
+    // center is the world-space point the draw's depth is taken at. See
+    // Renderer::add_to_mesh_batch for the rest.
+    void add(RenderLayer layer, ShaderHandle shader, TextureHandle texture, MeshHandle mesh, uint32_t range_mask,
+        vec4 origin, vec3 center, size_t query_id = NO_QUERY);
+
+    // Sorts and draws the packets added since begin. Query boxes added to
+    // the renderer are drawn after the opaque layer, against its depth.
+    void execute();
+
+    size_t packet_count() const noexcept { return m_Packets.size(); }
+    // Shader and texture binds of the last execute.
+    size_t state_changes() const noexcept { return m_StateChanges; }
+
+public:
+    // Handle indices and VAO names are cut to these many bits in the keys;
+    // packets whose state collides are only ordered less well.
+    static constexpr int LAYER_BITS = 2;
+    static constexpr int SHADER_BITS = 10;
+    static constexpr int TEXTURE_BITS = 10;
+    static constexpr int VERTEX_ARRAY_BITS = 10;
+    static constexpr int DEPTH_BITS = 32;
+    static_assert(LAYER_BITS + SHADER_BITS + TEXTURE_BITS + VERTEX_ARRAY_BITS + DEPTH_BITS == 64);
+
+private:
+    struct Packet {
+        RenderLayer layer;
+        ShaderHandle shader;
+        TextureHandle texture;
+        MeshHandle mesh;
+        uint32_t range_mask;
+        vec4 origin;
+        size_t query_id;
+    };
+
+    struct SortEntry {
+        uint64_t key;
+        uint32_t packet;
+    };
+
+    // LSD radix sort by key, a byte per pass; bytes equal in every key are
+    // skipped.
+    void sort() noexcept;
+
+private:
+    Renderer& m_Renderer;
+    mat4 m_View{1.0f};
+    mat4 m_Projection{1.0f};
+
+    std::vector<Packet> m_Packets;
+    std::vector<SortEntry> m_Entries;
+    std::vector<SortEntry> m_SortScratch;
+    size_t m_StateChanges = 0;
+};
+
+#endif //RENDER_QUEUE_H
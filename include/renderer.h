@@ -9,8 +9,15 @@
 #include "common.h"
 #include <vector>
 #include <unordered_map>
+#include <map>
 #include <string_view>
+#include <type_traits>
 #include "stack.h"
+#include "mesh.h"
+#include "arena_allocator.h"
+#include "gl_state.h"
+#include "stream_buffer.h"
+#include "slot_map.h"
 
 enum class RendererError {
     None = 0,
@@ -20,38 +27,93 @@ enum class RendererError {
     ShaderVertexError,
     ShaderFragmentError,
     ShaderLinkerError,
+    // Two of the program's uniforms hash to the same UniformName.
+    ShaderUniformCollision,
 };
 
-// vec3: Position
-// vec3: Normal
-// vec3: ColorBlend
-// vec2: UV
-constexpr size_t FLOATS_PER_VERTEX = 11;
+constexpr size_t VERTEX_BUFFER = 0;
+constexpr size_t INDEX_BUFFER = 1;
+
+constexpr uint32_t NO_ARENA_PAGE = UINT32_MAX;
+constexpr size_t NO_QUERY = static_cast<size_t>(-1);
 
-constexpr size_t OFFSET_OF_POSITION = 0;
-constexpr size_t OFFSET_OF_NORMAL = 3 * sizeof(float);
-constexpr size_t OFFSET_OF_COLOR = 6 * sizeof(float);
-constexpr size_t OFFSET_OF_UV = 9 * sizeof(float);
+// Per-draw (xyz offset, scale) of batched meshes, see chunk_vert.glsl. The
+// shaders see (0, 0, 0, 1) outside of a batch.
+constexpr uint32_t MESH_ORIGIN_ATTRIBUTE = 5;
 
-struct MeshBuffer {
-    std::vector<float> vertices;
-    std::vector<uint32_t> indices;
+// std140 layouts of the uniform blocks the shaders share, see chunk_vert.glsl.
+// Programs get their blocks bound to these points when linked.
+constexpr uint32_t CAMERA_BLOCK_BINDING = 0;
+constexpr uint32_t DRAW_BLOCK_BINDING = 1;
+
+struct CameraBlock {
+    mat4 projection;
+    mat4 view;
+    mat4 view_projection;
 };
 
-constexpr size_t VERTEX_BUFFER = 0;
-constexpr size_t INDEX_BUFFER = 1;
+struct DrawBlock {
+    mat4 model;
+};
+
+// Layout of one glMultiDrawElementsIndirect command.
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t base_vertex;
+    uint32_t base_instance;
+};
 
+// Meshes built with shared_quad_indices have no INDEX_BUFFER of their own.
+// Arena meshes own no GL objects at all: their vertices live at first_vertex
+// in a shared page, drawn through the page's VAO.
 struct Mesh {
     uint32_t array_buffer_id;
     uint32_t buffers[2];
     uint32_t index_count;
+    uint32_t index_type;
+    uint32_t arena_page = NO_ARENA_PAGE;
+    uint32_t first_vertex = 0;
+    uint32_t vertex_count = 0;
+    IndexRange ranges[MAX_INDEX_RANGES];
+    uint32_t range_count;
+};
+
+// FNV-1a of a uniform's name, the key uniforms are looked up by.
+constexpr uint32_t uniform_name_hash(std::string_view name) noexcept {
+    uint32_t hash = 2166136261u;
+    for (const char c : name) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+// A uniform's name as its hash. String literals are hashed at compile time;
+// other strings when converted.
+struct UniformName {
+    template <size_t N>
+    consteval UniformName(const char (&name)[N]) noexcept : hash{uniform_name_hash({name, N - 1})} {}
+    constexpr UniformName(std::string_view name) noexcept : hash{uniform_name_hash(name)} {}
+
+    uint32_t hash;
+};
+
+// A uniform outside any block, as glGetActiveUniform reports it; arrays
+// are named without their [0].
+struct ShaderUniform {
+    uint32_t name_hash;
+    int32_t location;
+    GLenum type;
+    int32_t count;
 };
 
 struct Shader {
     uint32_t program_id;
 private:
     friend class Renderer;
-    std::unordered_map<std::string, uint32_t> uniform_cache;
+    // Reflected once the program links, sorted by name_hash.
+    std::vector<ShaderUniform> uniforms;
 };
 
 struct Texture {
@@ -61,34 +123,31 @@ struct Texture {
     int32_t channels;
 };
 
-class MeshBuilder {
-public:
-    MeshBuilder(MeshBuffer& target);
-    ~MeshBuilder();
-
-    void clear() noexcept;
-
-    void add_vertex(vec3 position, vec3 normal, vec3 color, vec2 uv) noexcept;
-    void add_index(uint32_t index) noexcept;
-
-    void add_triangle(vec3 position0, vec3 position1, vec3 position2,
-                    vec3 color0, vec3 color1, vec3 color2,
-                     vec2 uv0, vec2 uv1, vec2 uv2, vec3 normal) noexcept;
-
-    void add_quad(vec3 position0, vec3 position1, vec3 position2, vec3 position3,
-        vec3 color0, vec3 color1, vec3 color2, vec3 color3,
-        vec2 uv0, vec2 uv1, vec2 uv2, vec2 uv3,
-        vec3 normal) noexcept;
-
-private:
-    MeshBuffer& m_Buffer;
-    uint32_t m_VertexCount = 0;
+// Meshes, shaders and textures are named by generational handles: one
+// whose resource was deleted is ignored everywhere, even after its slot is
+// reused.
+using MeshHandle = Handle<Mesh>;
+using ShaderHandle = Handle<Shader>;
+using TextureHandle = Handle<Texture>;
+
+// Names the index of a uniform of type T in the reflected uniforms of the
+// shader it was made for. set_uniform ignores invalid handles, and handles
+// of any shader other than the one in use, including a deleted one whose
+// program name GL has since reused.
+template <typename T>
+struct UniformHandle {
+    static constexpr uint32_t INVALID = UINT32_MAX;
+
+    uint32_t index = INVALID;
+    ShaderHandle shader;
+
+    bool valid() const noexcept { return index != INVALID; }
 };
 
 struct RendererStringResult {
     bool ok;
-    size_t mesh_id;
-    size_t texture_id;
+    MeshHandle mesh;
+    TextureHandle texture;
 };
 
 class Renderer {
@@ -101,26 +160,73 @@ public:
     Renderer& operator=(const Renderer&) = delete;
     Renderer& operator=(Renderer&&) noexcept;
 
-    size_t upload_texture(const char* file, bool v_flip) noexcept;
+    // An invalid handle if the file can't be loaded.
+    TextureHandle upload_texture(const char* file, bool v_flip) noexcept;
 
     RendererError create_window(const char* title, int width, int height, bool fullscreen) noexcept;
-    void swap_buffers() const noexcept;
+    // Ends the frame, including its region of the stream buffer.
+    void swap_buffers() noexcept;
 
     void set_clear_color(vec4 color) noexcept;
     void clear() const noexcept;
 
     RendererError create_text_shader(const char* vertex_source, const char* fragment_source) noexcept;
+    // The shader occlusion query boxes are drawn with; see box_vert.glsl.
+    RendererError create_box_shader(const char* vertex_source, const char* fragment_source) noexcept;
 
-    size_t upload_mesh(const MeshBuffer& buffer) noexcept;
-    RendererError upload_shader(const char* vertex_source, const char* fragment_source, size_t& shader_id) noexcept;
+    MeshHandle upload_mesh(const MeshBuffer& buffer) noexcept;
+    RendererError upload_shader(const char* vertex_source, const char* fragment_source, ShaderHandle& shader) noexcept;
     size_t upload_font(const char* filename, int size) noexcept;
 
-    void delete_mesh(size_t index) noexcept;
-    void delete_shader(size_t index) noexcept;
-    void delete_texture(size_t index) noexcept;
-
-    void use_shader(size_t shader_id) noexcept;
-    void render_mesh(size_t mesh_id) noexcept;
+    // Deleting through a dead handle does nothing.
+    void delete_mesh(MeshHandle mesh) noexcept;
+    // Moves arena meshes down into holes in pages whose free space is
+    // fragmented, copying at most byte_budget bytes on the GPU. Call once a
+    // frame so the work is spread out.
+    void compact_meshes(size_t byte_budget = MESH_COMPACT_BUDGET) noexcept;
+    void delete_shader(ShaderHandle shader) noexcept;
+    void delete_texture(TextureHandle texture) noexcept;
+
+    // An invalid handle unbinds any program; dead ones are ignored.
+    void use_shader(ShaderHandle shader) noexcept;
+
+    // The Camera block every program reads; uploaded only when it changes,
+    // and never on shader switches.
+    void set_camera(const mat4& view, const mat4& projection) noexcept;
+    // Streams the Draw block read by the draws after it through the stream
+    // buffer; the same block twice in a row is written once. Once the frame's
+    // stream region is full, blocks are uploaded to a buffer of their own.
+    void set_draw_block(const DrawBlock& block) noexcept;
+    void render_mesh(MeshHandle mesh) noexcept;
+    // Draws only the mesh's index ranges whose bit is set in range_mask,
+    // merging neighbouring ranges into one draw; meshes without ranges are
+    // drawn whole.
+    void render_mesh_ranges(MeshHandle mesh, uint32_t range_mask) noexcept;
+
+    // Collects mesh draws (as in render_mesh_ranges) with their origins and
+    // draws them on submit. With GL 4.3, arena meshes go out as a single
+    // glMultiDrawElementsIndirect per arena page, whatever their number;
+    // without it, and for other meshes, one draw per run of ranges. A mesh
+    // added with a query is drawn on its own, only if the query passed.
+    // Arena meshes are drawn in the order they were added, except that those
+    // between two queried meshes are grouped by page; the other meshes are
+    // drawn after them, in order.
+    void begin_mesh_batch() noexcept;
+    void add_to_mesh_batch(MeshHandle mesh, uint32_t range_mask, vec4 origin, size_t query_id = NO_QUERY) noexcept;
+    void submit_mesh_batch() noexcept;
+
+    // Occlusion queries tell whether any of a box passes the depth test.
+    // Boxes are collected and drawn on submit_query_boxes, with colour and
+    // depth writes off, each into its query. Meshes batched with the query
+    // are then drawn or skipped by the GPU (conditional rendering); they are
+    // drawn when the result isn't in yet, so the CPU never waits on it. Boxes
+    // are seen through the camera given to set_camera.
+    size_t create_query() noexcept;
+    void delete_query(size_t query_id) noexcept;
+    void add_query_box(size_t query_id, vec3 min, vec3 max) noexcept;
+    void submit_query_boxes() noexcept;
+
+    bool supports_multi_draw_indirect() const noexcept { return m_MultiDrawElementsIndirect != nullptr; }
 
     void render_text(size_t font_id, const char* text, int x, int y, vec3 color) noexcept;
 
@@ -128,20 +234,106 @@ public:
     void batch_render_text(const char* text, int x, int y, vec3 color) noexcept;
     void batch_render_text_end() noexcept;
 
-    void set_uniform(const std::string_view name, vec2 value);
-    void set_uniform(const std::string_view name, vec3 value);
-    void set_uniform(const std::string_view name, vec4 value);
-    void set_uniform(const std::string_view name, const mat4& value);
-    void set_uniform(const std::string_view name, int value);
-    void set_sampler(const std::string_view name, int slot, size_t texture_id);
+    // Uniforms of the shader in use, looked up by name hash in its
+    // reflected uniforms. Unknown names, and values of the wrong type, are
+    // ignored.
+    void set_uniform(UniformName name, vec2 value) noexcept;
+    void set_uniform(UniformName name, vec3 value) noexcept;
+    void set_uniform(UniformName name, vec4 value) noexcept;
+    void set_uniform(UniformName name, const mat4& value) noexcept;
+    void set_uniform(UniformName name, int value) noexcept;
+    void set_sampler(UniformName name, int slot, TextureHandle texture) noexcept;
+
+    // Handles skip the lookup: setting through one indexes the shader's
+    // uniforms directly. Invalid when the shader has no uniform of that
+    // name and type; ints also fit samplers.
+    template <typename T>
+    UniformHandle<T> uniform_handle(ShaderHandle shader, UniformName name) const noexcept {
+        const Shader* found = m_Shaders.get(shader);
+        if (!found) return {};
+        return {find_uniform(*found, name.hash, uniform_type<T>()), shader};
+    }
+    void set_uniform(UniformHandle<vec2> handle, vec2 value) noexcept;
+    void set_uniform(UniformHandle<vec3> handle, vec3 value) noexcept;
+    void set_uniform(UniformHandle<vec4> handle, vec4 value) noexcept;
+    void set_uniform(UniformHandle<mat4> handle, const mat4& value) noexcept;
+    void set_uniform(UniformHandle<int> handle, int value) noexcept;
+    // Binds the texture to the unit without touching any sampler uniform.
+    void bind_texture(int slot, TextureHandle texture) noexcept;
+
+    // The VAO the mesh is drawn through, shared by every mesh of an arena
+    // page; 0 for dead meshes.
+    uint32_t mesh_vertex_array(MeshHandle mesh) const noexcept;
+
+    // GL state calls made and dropped as redundant since the last reset.
+    size_t state_calls_issued() const noexcept { return m_State.issued(); }
+    size_t state_calls_elided() const noexcept { return m_State.elided(); }
+    void reset_state_counters() noexcept { m_State.reset_counters(); }
+
+    bool mesh_is_dead(MeshHandle mesh) const noexcept { return !m_Meshes.contains(mesh); }
+    bool shader_is_dead(ShaderHandle shader) const noexcept { return !m_Shaders.contains(shader); }
+    bool texture_is_dead(TextureHandle texture) const noexcept { return !m_Textures.contains(texture); }
 
-    bool mesh_is_dead(size_t index) const;
-    bool shader_is_dead(size_t index) const;
-    bool texture_is_dead(size_t index) const;
+public:
+    // Quad-only packed meshes (chunk sections) are sub-allocated from pages of
+    // ARENA_PAGE_VERTICES vertices (16 MB) instead of getting their own VAO
+    // and buffers.
+    static constexpr uint32_t ARENA_PAGE_VERTICES = 1u << 21;
+    // A page is compacted once this share of its free space is outside its
+    // largest hole, and it has at least ARENA_COMPACT_MIN_FREE vertices free.
+    static constexpr float ARENA_COMPACT_FRAGMENTATION = 0.5f;
+    static constexpr uint32_t ARENA_COMPACT_MIN_FREE = ARENA_PAGE_VERTICES / 16;
+    static constexpr size_t MESH_COMPACT_BUDGET = 1 << 20;
+    // Bytes of text vertices and draw blocks a frame can stream.
+    static constexpr size_t STREAM_FRAME_SIZE = 1 << 20;
 private:
     RendererError initialize_opengl() noexcept;
 
-    uint32_t get_loc(const std::string_view name) noexcept;
+    // The GL type a uniform set as T must have; ints also fit samplers.
+    template <typename T>
+    static constexpr GLenum uniform_type() noexcept {
+        if constexpr (std::is_same_v<T, vec2>) return GL_FLOAT_VEC2;
+        else if constexpr (std::is_same_v<T, vec3>) return GL_FLOAT_VEC3;
+        else if constexpr (std::is_same_v<T, vec4>) return GL_FLOAT_VEC4;
+        else if constexpr (std::is_same_v<T, mat4>) return GL_FLOAT_MAT4;
+        else {
+            static_assert(std::is_same_v<T, int>);
+            return GL_INT;
+        }
+    }
+
+    // Index of the shader's uniform with the name hash and type, or
+    // UniformHandle::INVALID.
+    static uint32_t find_uniform(const Shader& shader, uint32_t name_hash, GLenum type) noexcept;
+    // Location in the shader in use, or -1.
+    int32_t get_loc(UniformName name, GLenum type) const noexcept;
+    int32_t get_loc(uint32_t handle_index) const noexcept;
+    // -1 as well when the handle is for another shader.
+    int32_t get_loc(ShaderHandle shader, uint32_t handle_index) const noexcept;
+
+    // Fills shader.uniforms from the linked program. Fails when two of them
+    // can't be told apart by UniformName.
+    static RendererError reflect_uniforms(Shader& shader) noexcept;
+
+    // Attribute setup for VertexLayout::Float on the bound VAO and buffer.
+    void upload_float_vertex_layout() noexcept;
+
+    // Binds a shared quad index buffer covering vertex_count vertices to the
+    // bound VAO, growing it if needed; returns its index type.
+    uint32_t bind_quad_indices(size_t vertex_count) noexcept;
+
+    // Places the mesh in an arena page, adding a page if none has room;
+    // false if the buffer can't go in the arena.
+    bool upload_arena_mesh(const MeshBuffer& buffer, MeshHandle handle, Mesh& mesh) noexcept;
+    void create_arena_page() noexcept;
+
+    // One glDrawElementsBaseVertex of count indices starting at first.
+    void draw_mesh_indices(const Mesh& mesh, uint32_t first, uint32_t count) noexcept;
+    // Binds the mesh's VAO and draws the runs of ranges selected by range_mask.
+    void draw_mesh_ranges(const Mesh& mesh, uint32_t range_mask) noexcept;
+    // Moves the commands collected per page in m_BatchCommands to the end of
+    // m_IndirectCommands, one BatchDraw per page.
+    void close_batch_pages() noexcept;
 
     size_t create_virtual_font(size_t font_id, int atlasWidth, int atlasHeight);
     int estimate_atlas_size(size_t font_id, int padding = 2) const noexcept;
@@ -156,19 +348,70 @@ private:
         int bearing_x, bearing_y;
     };
 
+    // Pre-built QUAD_INDICES for quad_capacity quads. The 16-bit one serves
+    // meshes of up to 65536 vertices, which covers every chunk section.
+    struct QuadIndexBuffer {
+        uint32_t buffer_id = 0;
+        size_t quad_capacity = 0;
+    };
+
+    // meshes maps each mesh's first_vertex to its handle, so compaction can
+    // walk them from the top of the page down.
+    struct ArenaPage {
+        uint32_t array_buffer_id = 0;
+        uint32_t vertex_buffer_id = 0;
+        ArenaAllocator allocator{ARENA_PAGE_VERTICES};
+        std::map<uint32_t, MeshHandle> meshes;
+    };
+
+    struct BatchedMesh {
+        MeshHandle mesh;
+        uint32_t range_mask;
+        vec4 origin;
+        size_t query_id;
+    };
+
+    // Commands in m_IndirectCommands of arena meshes in one page, under the
+    // same query or none, drawn with one glMultiDrawElementsIndirect.
+    struct BatchDraw {
+        uint32_t arena_page;
+        size_t query_id;
+        size_t first_command;
+        size_t command_count;
+    };
+
+    // glMultiDrawElementsIndirect is loaded by hand, as it is newer than the
+    // 3.3 core context the game asks for.
+    typedef void (APIENTRY *MultiDrawElementsIndirectFunction)(GLenum mode, GLenum type,
+        const void* indirect, GLsizei draw_count, GLsizei stride);
+
     struct Font {
-        size_t texture_id;
+        TextureHandle texture;
         std::unordered_map<char, Glyph> glyphs;
         int atlasWidth, atlasHeight;
         size_t true_font_id;
-        Mesh text_mesh;
+        // Reads the stream buffer; made on the font's first draw.
+        uint32_t text_array_id = 0;
     };
 
+    // Streams text vertices (x, y, u, v, r, g, b) and draws them with the
+    // font's atlas, over the scene.
+    void draw_text_vertices(Font& font, const std::vector<float>& vertices) noexcept;
+
 private:
     SDL_GLContext m_Context = nullptr;
+    // Every program, VAO, buffer and texture bind and every capability,
+    // mask and viewport change goes through here. Buffers are left bound
+    // after use, as it knows what is.
+    GLState m_State;
+    // Every frame's text vertices and draw blocks.
+    StreamBuffer m_Stream;
     SDL_Window* m_Window = nullptr;
     vec4 m_ClearColor = vec4{0.0f};
+    // Points into m_Shaders, the font shader or the box shader, so it is
+    // looked up again from m_CurrentShaderHandle whenever m_Shaders changes.
     Shader* m_CurrentShader = nullptr;
+    ShaderHandle m_CurrentShaderHandle;
 
     std::vector<float> m_BatchTextVertices{600};
     size_t m_BatchFontID = -1;
@@ -176,17 +419,56 @@ private:
     mat4 m_GuiProjection{1.0f};
 
     Shader m_FontShader;
-
-    std::vector<Mesh> m_Meshes;
-    std::vector<Shader> m_Shaders;
-    std::vector<Texture> m_Textures;
+    Shader m_BoxShader;
+
+    SlotMap<Mesh> m_Meshes;
+    QuadIndexBuffer m_QuadIndices16;
+    QuadIndexBuffer m_QuadIndices32;
+    std::vector<ArenaPage> m_ArenaPages;
+
+    MultiDrawElementsIndirectFunction m_MultiDrawElementsIndirect = nullptr;
+    // Indirect draws read their origin through base_instance, as an instanced
+    // attribute of the arena pages' VAOs sourced from m_OriginBuffer. Origin 0
+    // is always the identity, for arena meshes drawn with render_mesh.
+    uint32_t m_OriginBuffer = 0;
+    uint32_t m_IndirectBuffer = 0;
+    std::vector<vec4> m_BatchOrigins;
+    std::vector<std::vector<DrawElementsIndirectCommand>> m_BatchCommands;
+    std::vector<DrawElementsIndirectCommand> m_IndirectCommands;
+    std::vector<BatchedMesh> m_BatchMeshes;
+    // In the order they are drawn. Meshes without a query collect per page
+    // in m_BatchCommands until a queried one (or submit) closes them into
+    // draws of their own.
+    std::vector<BatchDraw> m_BatchDraws;
+
+    uint32_t m_CameraBuffer = 0;
+    CameraBlock m_Camera{};
+    bool m_CameraSet = false;
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, which draw blocks start at.
+    size_t m_UniformAlignment = 1;
+    // The block last streamed this frame and its offset, reused while it is
+    // unchanged.
+    static constexpr size_t NO_DRAW_BLOCK_SLOT = static_cast<size_t>(-1);
+    DrawBlock m_DrawBlock{};
+    size_t m_DrawBlockSlot = NO_DRAW_BLOCK_SLOT;
+    // Holds the block instead when the stream region has no room left.
+    uint32_t m_DrawBuffer = 0;
+
+    // Query boxes are 8 corners each in m_BoxVertexBuffer, drawn with the
+    // 36 indices of m_BoxIndexBuffer at base vertex 8 * box.
+    std::vector<uint32_t> m_Queries;
+    std::vector<size_t> m_QueryBoxIds;
+    std::vector<vec3> m_QueryBoxVertices;
+    uint32_t m_BoxVertexArray = 0;
+    uint32_t m_BoxVertexBuffer = 0;
+    uint32_t m_BoxIndexBuffer = 0;
+    SlotMap<Shader> m_Shaders;
+    SlotMap<Texture> m_Textures;
 
     std::vector<TTF_Font*> m_Fonts;
     std::vector<Font> m_VirtualFonts;
 
-    stack<size_t> m_DeadMeshes;
-    stack<size_t> m_DeadShaders;
-    stack<size_t> m_DeadTextures;
+    stack<size_t> m_DeadQueries;
 };
 
 
@@ -0,0 +1,109 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Names a value of a SlotMap<T>: its slot, and the generation the slot was
+// at when the value went in. Erasing the value moves the slot to the next
+// generation, so the handle stays dead even once the slot is reused.
+// Default handles name nothing.
+template <typename T>
+struct Handle {
+    static constexpr uint32_t NO_INDEX = UINT32_MAX;
+
+    uint32_t index = NO_INDEX;
+    uint32_t generation = 0;
+
+    bool valid() const noexcept { return index != NO_INDEX; }
+
+    friend bool operator==(Handle, Handle) noexcept = default;
+};
+
+// Values kept packed in one vector, reached from handles through slots.
+// insert, erase, contains and get are all O(1). Erasing moves the last value
+// into the hole, so pointers to values only last until the next insert or
+// erase; handles last until their own value is erased.
+template <typename T>
+class SlotMap {
+public:
+    Handle<T> insert(T value) {
+        uint32_t index;
+        if (m_FreeSlots.empty()) {
+            index = static_cast<uint32_t>(m_Slots.size());
+            m_Slots.emplace_back();
+        }
+        else {
+            index = m_FreeSlots.back();
+            m_FreeSlots.pop_back();
+        }
+
+        Slot& slot = m_Slots[index];
+        slot.value = static_cast<uint32_t>(m_Values.size());
+        m_Values.push_back(std::move(value));
+        m_ValueSlots.push_back(index);
+        return {index, slot.generation};
+    }
+
+    // False if the handle was already dead.
+    bool erase(Handle<T> handle) {
+        if (!contains(handle)) return false;
+
+        Slot& slot = m_Slots[handle.index];
+        const uint32_t last = static_cast<uint32_t>(m_Values.size() - 1);
+        if (slot.value != last) {
+            m_Values[slot.value] = std::move(m_Values[last]);
+            m_ValueSlots[slot.value] = m_ValueSlots[last];
+            m_Slots[m_ValueSlots[last]].value = slot.value;
+        }
+        m_Values.pop_back();
+        m_ValueSlots.pop_back();
+
+        slot.generation++;
+        m_FreeSlots.push_back(handle.index);
+        return true;
+    }
+
+    bool contains(Handle<T> handle) const noexcept {
+        return handle.index < m_Slots.size() && m_Slots[handle.index].generation == handle.generation;
+    }
+
+    // nullptr for dead handles.
+    T* get(Handle<T> handle) noexcept {
+        return contains(handle) ? &m_Values[m_Slots[handle.index].value] : nullptr;
+    }
+    const T* get(Handle<T> handle) const noexcept {
+        return contains(handle) ? &m_Values[m_Slots[handle.index].value] : nullptr;
+    }
+
+    size_t size() const noexcept { return m_Values.size(); }
+    bool empty() const noexcept { return m_Values.empty(); }
+
+    // The live values, in no particular order.
+    T* begin() noexcept { return m_Values.data(); }
+    T* end() noexcept { return m_Values.data() + m_Values.size(); }
+    const T* begin() const noexcept { return m_Values.data(); }
+    const T* end() const noexcept { return m_Values.data() + m_Values.size(); }
+
+private:
+    struct Slot {
+        // Index in m_Values while live.
+        uint32_t value = 0;
+        uint32_t generation = 0;
+    };
+
+private:
+    std::vector<T> m_Values;
+    // The slot of each value, to fix it up when the value moves.
+    std::vector<uint32_t> m_ValueSlots;
+    std::vector<Slot> m_Slots;
+    std::vector<uint32_t> m_FreeSlots;
+};
+
+#endif //SLOT_MAP_H
@@ -0,0 +1,65 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include "gl_state.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// One buffer for data rewritten every frame (text, per-draw uniforms, ...),
+// split in FRAMES regions used round robin. Each frame writes into its own
+// region, and a fence at the end of the frame guards it until the GPU is
+// done reading, so writes never wait on draws and storage is never
+// reallocated. With GL 4.4 the buffer is created with glBufferStorage and
+// stays mapped; otherwise each write maps its range unsynchronized, which
+// the fences make just as safe.
+class StreamBuffer {
+public:
+    StreamBuffer() noexcept = default;
+    StreamBuffer(const StreamBuffer&) = delete;
+
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // Needs a current context. frame_size bytes are available each frame.
+    void create(GLState& state, size_t frame_size) noexcept;
+    // Frees the GL objects; the context must still be current.
+    void destroy() noexcept;
+
+    // Moves to the next region, waiting for the GPU to finish the frame
+    // that last used it, and fences the one just written. Call once a frame,
+    // after its last draw.
+    void next_frame() noexcept;
+
+    // Room for bytes at an offset, from the start of the buffer, that is a
+    // multiple of alignment (which need not be a power of two). nullptr
+    // when the frame's region is full. Write all of it, then call unmap.
+    void* map(size_t bytes, size_t alignment, size_t& offset) noexcept;
+    void unmap() noexcept;
+    // map, copy and unmap; false when the region is full.
+    bool write(const void* data, size_t bytes, size_t alignment, size_t& offset) noexcept;
+
+    uint32_t buffer() const noexcept { return m_Buffer; }
+    bool persistent() const noexcept { return m_Mapped != nullptr; }
+
+public:
+    static constexpr size_t FRAMES = 3;
+
+private:
+    typedef void (APIENTRY *BufferStorageFunction)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+private:
+    GLState* m_State = nullptr;
+    uint32_t m_Buffer = 0;
+    uint8_t* m_Mapped = nullptr;
+    size_t m_FrameSize = 0;
+    size_t m_Frame = 0;
+    // Next free byte of the current region, from the buffer's start.
+    size_t m_Offset = 0;
+    GLsync m_Fences[FRAMES] {};
+};
+
+#endif //STREAM_BUFFER_H
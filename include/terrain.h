@@ -9,60 +9,299 @@
 
 #include <vector>
 #include <string>
-#include <any>
+#include <memory>
+#include <mutex>
+#include <deque>
 #include <unordered_map>
-#include <random>
+#include <algorithm>
 
 #include "renderer.h"
+#include "render_queue.h"
+#include "chunk.h"
+#include "chunk_io.h"
+#include "mesher.h"
+#include "frustum.h"
+#include "occlusion.h"
+#include "worldgen.h"
+#include "thread_pool.h"
 
-typedef uint16_t block_t;
-
-enum class Material {
-    Void,
-    Dirt,
-    Stone,
-    Grass,
-    Wood,
-    Iron,
-    Copper,
-    INVALID
+// How render skips sections that are inside the frustum but hidden behind
+// terrain, on top of skipping chunks out of reach through cave air.
+enum class OcclusionCulling {
+    None,
+    // The nearest chunks' solid hulls are drawn into an OcclusionBuffer.
+    Software,
+    // Each chunk's box is tested on the GPU with an occlusion query, and its
+    // sections are drawn under last frame's result for it.
+    Queries,
 };
 
 class VoxelEntity {
 public:
-    VoxelEntity(int seed = 0);
+    // The world's seed and erosion come from save_directory's world info
+    // (see diggy_worldgen); seed is only used when it has none.
+    VoxelEntity(Renderer& renderer, int seed = 0, std::string save_directory = "world");
+    VoxelEntity(const VoxelEntity&) = delete;
     ~VoxelEntity();
 
-    void render(float player_x, float player_y, float player_z);
+    VoxelEntity& operator=(const VoxelEntity&) = delete;
+
+    // Streams the chunks around the camera, nearest first: loading and meshing
+    // run on worker threads, finished meshes are uploaded here within
+    // UPLOAD_BUDGET_MS, and chunks that fell out of range are dropped. Pass
+    // the same eye position as render, so the loaded set and LOD rings are
+    // centred where culling is.
+    void update(float eye_x, float eye_y, float eye_z);
+
+    // Queues every section inside the view frustum, with the shader and
+    // texture of set_draw_state, as opaque packets. Takes the camera's
+    // projection * view and its position, which decides the face directions
+    // that are drawn. Chunks the camera can't see into through the air of the
+    // chunks in between (see find_reachable_chunks) are skipped as well, and
+    // so are sections found hidden by occlusion_culling().
+    void render(RenderQueue& queue, const mat4& view_projection, float eye_x, float eye_y, float eye_z);
+    // The terrain shader (see VERTEX_LAYOUT) and texture atlas.
+    void set_draw_state(ShaderHandle shader, TextureHandle texture) noexcept { m_Shader = shader; m_Texture = texture; }
+
+    // Queries needs the renderer's box shader (see create_box_shader).
+    void set_occlusion_culling(OcclusionCulling mode) noexcept { m_OcclusionCulling = mode; }
+    OcclusionCulling occlusion_culling() const noexcept { return m_OcclusionCulling; }
+
+    // Counts from the last render, per level of the culling hierarchy.
+    // chunks_hidden are in the frustum but out of reach of the camera.
+    struct CullStats {
+        size_t chunks_hidden = 0;
+        size_t regions_culled = 0;
+        size_t chunks_culled = 0;
+        size_t sections_culled = 0;
+        size_t sections_occluded = 0;
+        size_t chunks_queried = 0;
+        size_t sections_visible = 0;
+        size_t boxes_tested = 0;
+        size_t occluder_quads = 0;
+        // All of render, and the part of it spent testing boxes against
+        // the frustum.
+        double milliseconds = 0.0;
+        double frustum_milliseconds = 0.0;
+    };
+    const CullStats& cull_stats() const noexcept { return m_CullStats; }
+
+    // Voxel coordinates are world-space positions divided by VOXEL_SIZE.
+    // Unloaded voxels read as Material::INVALID and can't be set.
+    Material get_voxel(int32_t x, int32_t y, int32_t z) const noexcept;
+    // Only the 16^3 sections the voxel and its neighbours touch are remeshed,
+    // in this chunk or the ones across the border; the remesh jumps the job queue.
+    bool set_voxel(int32_t x, int32_t y, int32_t z, Material material);
+
+    // Steps through voxels along the ray (world-space) and reports the first
+    // solid one within max_distance.
+    bool raycast(vec3 origin, vec3 direction, float max_distance, int32_t& hit_x, int32_t& hit_y, int32_t& hit_z) const noexcept;
 
 public:
     static constexpr size_t VOXEL_SIZE = 2;
-    static constexpr size_t CHUNK_SIZE_X = 32;
-    static constexpr size_t CHUNK_SIZE_Y = 32;
-    static constexpr size_t CHUNK_SIZE_Z = 32;
+    static constexpr size_t CHUNK_SIZE_X = ::CHUNK_SIZE_X;
+    static constexpr size_t CHUNK_SIZE_Y = ::CHUNK_SIZE_Y;
+    static constexpr size_t CHUNK_SIZE_Z = ::CHUNK_SIZE_Z;
     static constexpr size_t WORLD_CHUNKS_COUNT_X = 64;
     static constexpr size_t WORLD_CHUNKS_COUNT_Y = 64;
     static constexpr size_t WORLD_CHUNKS_COUNT_Z = 64;
-    static constexpr size_t WORLD_QUADRANT_COUNT = (WORLD_CHUNKS_COUNT_X * WORLD_CHUNKS_COUNT_Y * WORLD_CHUNKS_COUNT_Z) / 2;
+
+    static constexpr int VIEW_RADIUS_XZ = 8;
+    static constexpr int VIEW_RADIUS_Y = 2;
+    // Frustum culling tests blocks of CULL_REGION_SIZE^3 chunks first, then
+    // the chunks of blocks that cross the frustum, then their sections; all
+    // of a box that is wholly inside is drawn without further tests.
+    static constexpr int CULL_REGION_SIZE = 4;
+    // Chunks within this many chunks (Chebyshev) of the camera's draw their
+    // ChunkOccluder into the occlusion buffer.
+    static constexpr int OCCLUDER_RADIUS = 2;
+    // Query boxes are grown by this much (world units), so the faces of the
+    // chunk itself and of its neighbours never hide them. Chunks whose grown
+    // box comes this close to the camera are drawn without a query.
+    static constexpr float QUERY_BOX_MARGIN = 0.5f;
+
+    // Chunks are meshed from 1x, 2x, 4x or 8x downsampled voxels by chunk
+    // distance (Chebyshev) from the player: level n up to LOD_DISTANCES[n].
+    // The ranges double, so each level costs about as many triangles as the
+    // last. A chunk only moves to a coarser level once it is LOD_HYSTERESIS
+    // chunks past the boundary, so walking along one doesn't remesh it.
+    static constexpr size_t LOD_COUNT = 4;
+    static constexpr int LOD_DISTANCES[LOD_COUNT - 1] {1, 2, 4};
+    static constexpr int LOD_HYSTERESIS = 1;
+    static constexpr uint8_t NO_LOD = UINT8_MAX;
+    // Caps the jobs queued per worker so that nearer chunks aren't stuck
+    // behind a long backlog when the player moves.
+    static constexpr size_t JOBS_PER_WORKER = 4;
+    static constexpr double UPLOAD_BUDGET_MS = 2.0;
+    // Packed meshes need chunk_vert.glsl as the terrain vertex shader.
+    static constexpr VertexLayout VERTEX_LAYOUT = VertexLayout::Packed;
 private:
-    struct Chunk {
-        Material voxels[CHUNK_SIZE_X * CHUNK_SIZE_Y * CHUNK_SIZE_Z];
-        size_t visual_mesh_id;
+    // data is null while the chunk loads. It is never modified in place:
+    // edits swap in a copy, so mesh jobs can hold on to the one they started
+    // with. Each section has its own mesh and a version that changes whenever
+    // the section is marked dirty, so stale mesh results are recognised. lod
+    // is the level the chunk is meshed at, see LOD_DISTANCES. face_connections
+    // come with the newest mesh job (connectivity_version) and are complete
+    // until the first one finishes, as is the occluder, which is built from
+    // the full resolution voxels whatever the lod. border_lod is the level
+    // the chunk left since its last mesh job, whose neighbours' borders the
+    // next job checks, or NO_LOD. query is the chunk's index into the query
+    // pool of frame query_frame, for a box around its queried_sections.
+    struct ChunkSlot {
+        std::shared_ptr<const Chunk> data;
+        uint8_t lod = 0;
+        uint8_t border_lod = NO_LOD;
+        uint64_t face_connections = ALL_FACE_CONNECTIONS;
+        uint64_t connectivity_version = 0;
+        ChunkOccluder occluder;
+        uint32_t dirty_sections = 0;
+        uint64_t section_versions[SECTION_COUNT]{};
+        MeshHandle section_meshes[SECTION_COUNT];
+        uint64_t query_frame = 0;
+        uint32_t query = 0;
+        uint32_t queried_sections = 0;
+
+    };
+
+    struct LoadResult {
+        ChunkCoord coord;
+        std::shared_ptr<const Chunk> data;
+    };
+
+    struct SectionBuffers {
+        MeshBuffer sections[SECTION_COUNT];
+    };
+
+    // Chunks [from, to] of one culling region, or a chunk that needs its
+    // sections tested.
+    struct CullRegion {
+        ChunkCoord from, to;
+    };
+    struct CullChunk {
+        ChunkSlot* slot;
+        vec3 origin;
+    };
+    // A chunk reached through entered_face (FACE_DIRECTION_COUNT for the
+    // camera's own), having stepped along the directions bits so far.
+    struct ReachStep {
+        ChunkCoord coord;
+        uint8_t entered_face;
+        uint8_t directions;
     };
 
-    Chunk& get_chunk(float x, float y, float z);
+    struct MeshResult {
+        ChunkCoord coord;
+        uint32_t sections;
+        uint64_t versions[SECTION_COUNT];
+        uint64_t connectivity_version;
+        uint64_t face_connections;
+        ChunkOccluder occluder;
+        std::shared_ptr<SectionBuffers> buffers;
+        uint8_t border_lod = NO_LOD;
+        // Per face, the sections of that neighbour to remesh for the move
+        // from border_lod.
+        uint32_t neighbour_sections[FACE_DIRECTION_COUNT]{};
+    };
+
+    static ChunkCoord chunk_coord_of(float x, float y, float z) noexcept;
+    static vec3 chunk_origin(ChunkCoord coord) noexcept;
+
+    // Loads the chunk from the save directory (see diggy_worldgen), generating
+    // it only when no pre-generated file exists. Safe to call from workers.
+    std::shared_ptr<const Chunk> load_chunk(ChunkCoord coord) const;
 
+    ChunkSlot* find_chunk(ChunkCoord coord) noexcept;
+    const ChunkSlot* find_chunk(ChunkCoord coord) const noexcept;
+
+    // Regenerates the chunk in place and queues it for remeshing.
     void generate_chunk(float x, float y, float z);
-    void generate_chunk_mesh(float x, float y, float z);
+
+    // Queues a mesh job for the chunk's dirty sections once its neighbours are
+    // loaded; returns whether a job was submitted.
+    bool generate_chunk_mesh(float x, float y, float z);
+    bool generate_chunk_mesh(ChunkCoord coord, bool urgent = false);
+
+    // Moves chunks between LOD levels as the player moves. Changed chunks
+    // are remeshed; their mesh jobs work out which border sections of the
+    // neighbours changed with them, and drain_meshes dirties those.
+    void update_lods(ChunkCoord center);
+
+    void mark_dirty(ChunkSlot& slot, uint32_t sections) noexcept;
+    // After an edit: drops the chunk's occluder and face connections, and
+    // the ones in-flight mesh jobs would bring, until a job started on the
+    // new voxels finishes.
+    void reset_visibility(ChunkSlot& slot) noexcept;
+    // Marks the section holding chunk-local voxel (x, y, z), which may lie one
+    // voxel outside the chunk, i.e. in a neighbour.
+    void mark_voxel_dirty(ChunkCoord coord, int x, int y, int z);
+
+    void drain_loads(ChunkCoord center);
+    void drain_meshes();
+
+    // Flood fills the view box from the camera's chunk into m_ReachableChunks:
+    // a step leaves a chunk only through faces connected to the one it came
+    // in by, and never back towards the camera. Chunks that are not meshed
+    // yet count as open.
+    void find_reachable_chunks(ChunkCoord center);
+
+    // Draws the occluders of the reachable chunks within OCCLUDER_RADIUS;
+    // columns of equal height are merged along x.
+    void draw_occluders(ChunkCoord center);
+
+    static uint32_t meshed_sections(const ChunkSlot& slot) noexcept;
+    // Queues the chunk's meshed sections among sections that aren't occluded
+    // and counts them. With OcclusionCulling::Queries they are
+    // drawn under the chunk's query from the last frame, if it covered them
+    // all, and queried again.
+    void add_chunk_to_queue(RenderQueue& queue, ChunkSlot& slot, vec3 origin, vec3 eye, uint32_t sections = ALL_SECTIONS);
+    // Index of a free query in this frame's pool.
+    uint32_t next_chunk_query();
+
+    void release_mesh(ChunkSlot& slot, size_t section) noexcept;
+    void release_meshes(ChunkSlot& slot) noexcept;
 private:
-    Chunk Quadrant1[WORLD_QUADRANT_COUNT]; // +x +y +z
-    Chunk Quadrant2[WORLD_QUADRANT_COUNT]; // -x +y +z
-    Chunk Quadrant3[WORLD_QUADRANT_COUNT]; // -x +y -z
-    Chunk Quadrant4[WORLD_QUADRANT_COUNT]; // +x +y -z
-    Chunk Quadrant5[WORLD_QUADRANT_COUNT]; // +x -y +z
-    Chunk Quadrant6[WORLD_QUADRANT_COUNT]; // -x -y +z
-    Chunk Quadrant7[WORLD_QUADRANT_COUNT]; // -x -y -z
-    Chunk Quadrant8[WORLD_QUADRANT_COUNT]; // +x -y -z
+    Renderer& m_Renderer;
+    ShaderHandle m_Shader;
+    TextureHandle m_Texture;
+    WorldInfo m_WorldInfo;
+    WorldGenerator m_Generator;
+    std::string m_SaveDirectory;
+    // Only for worlds pre-generated with erosion, see the constructor.
+    std::unique_ptr<TerrainErosion> m_Erosion;
+
+    std::unordered_map<ChunkCoord, std::unique_ptr<ChunkSlot>, ChunkCoordHash> m_Chunks;
+    uint64_t m_NextVersion = 0;
+    size_t m_JobsInFlight = 0;
+
+    // Chunks with sections dirtied by edits, remeshed ahead of streaming.
+    std::vector<ChunkCoord> m_EditedChunks;
+
+    // Filled by the workers, drained on the main thread.
+    std::mutex m_ResultMutex;
+    std::vector<LoadResult> m_LoadResults;
+    std::deque<MeshResult> m_MeshResults;
+    std::vector<std::shared_ptr<SectionBuffers>> m_FreeBuffers;
+
+    // Culling scratch, kept between frames. m_ReachableChunks covers the view
+    // box around the camera, x fastest, then z, then y.
+    CullStats m_CullStats;
+    AabbList m_CullBoxes;
+    std::vector<CullResult> m_CullResults;
+    std::vector<CullRegion> m_CullRegions;
+    std::vector<CullChunk> m_CullChunks;
+    std::vector<ReachStep> m_ReachQueue;
+    std::vector<uint8_t> m_ReachableChunks;
+    OcclusionBuffer m_Occlusion;
+
+    // Chunk queries alternate between two pools by frame parity, so a query
+    // this frame draws under isn't issued again before the next one.
+    OcclusionCulling m_OcclusionCulling = OcclusionCulling::Software;
+    uint64_t m_Frame = 0;
+    std::vector<size_t> m_ChunkQueries[2];
+    size_t m_ChunkQueriesUsed = 0;
+
+    // Declared last so it is joined before the queues above go away.
+    ThreadPool m_Workers;
 };
 
 
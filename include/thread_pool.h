@@ -0,0 +1,60 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // thread_count == 0 uses every hardware thread.
+    explicit ThreadPool(size_t thread_count = 0);
+    ThreadPool(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> job);
+    // Queues the job ahead of everything not yet started.
+    void submit_front(std::function<void()> job);
+
+    // Blocks until every submitted job has finished.
+    void wait() noexcept;
+
+    // Runs job(i) for i in [0, count) spread over the workers and the
+    // calling thread, and returns once job has run for every index. Only
+    // this call's indices are waited for, never the pool's other work, so
+    // workers may call it as well.
+    void parallel_for(size_t count, const std::function<void(size_t)>& job);
+    // Like parallel_for, but the jobs go ahead of the queue.
+    void parallel_for_front(size_t count, const std::function<void(size_t)>& job);
+
+    size_t thread_count() const noexcept { return m_Workers.size(); }
+
+    static size_t hardware_threads() noexcept;
+
+private:
+    void worker_main() noexcept;
+    void run_parallel(size_t count, const std::function<void(size_t)>& job, bool front);
+
+private:
+    std::vector<std::thread> m_Workers;
+    std::deque<std::function<void()>> m_Jobs;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_JobReady;
+    std::condition_variable m_AllDone;
+
+    size_t m_Active = 0;
+    bool m_Stopping = false;
+};
+
+#endif //THREAD_POOL_H
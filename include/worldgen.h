@@ -0,0 +1,69 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#ifndef WORLDGEN_H
+#define WORLDGEN_H
+
+#include <cstdint>
+
+#include "chunk.h"
+
+class TerrainErosion;
+
+enum class GenerationStage {
+    Heightmap,
+    Fill,
+    Caves,
+    Ores,
+    STAGE_END
+};
+
+constexpr size_t GENERATION_STAGE_COUNT = static_cast<size_t>(GenerationStage::STAGE_END);
+
+const char* generation_stage_name(GenerationStage stage) noexcept;
+
+// Seconds spent in each stage, accumulated across calls.
+struct GenerationTimings {
+    double seconds[GENERATION_STAGE_COUNT]{0.0};
+
+    GenerationTimings& operator+=(const GenerationTimings& other) noexcept {
+        for (size_t i = 0; i < GENERATION_STAGE_COUNT; i++) {
+            seconds[i] += other.seconds[i];
+        }
+        return *this;
+    }
+};
+
+// Stateless apart from the seed and the (thread-safe) erosion stage, so one
+// generator can be shared by any number of threads.
+class WorldGenerator {
+public:
+    explicit WorldGenerator(uint32_t seed = 0);
+
+    void generate_chunk(ChunkCoord coord, Chunk& out, GenerationTimings* timings = nullptr) const noexcept;
+
+    // Surface height in voxels at a world voxel column, eroded when an
+    // erosion stage is attached.
+    int surface_height(int32_t world_x, int32_t world_z) const noexcept;
+
+    // Noise heightmap before erosion.
+    float raw_height(int32_t world_x, int32_t world_z) const noexcept;
+
+    // Optional; the erosion stage must outlive the generator.
+    void set_erosion(TerrainErosion* erosion) noexcept { m_Erosion = erosion; }
+
+    uint32_t seed() const noexcept { return m_Seed; }
+
+public:
+    static constexpr int BASE_HEIGHT = 24;
+    static constexpr int HEIGHT_AMPLITUDE = 24;
+    static constexpr int DIRT_DEPTH = 4;
+    static constexpr int CAVE_FLOOR = -160;
+
+private:
+    uint32_t m_Seed;
+    TerrainErosion* m_Erosion = nullptr;
+};
+
+#endif //WORLDGEN_H
@@ -51,6 +51,9 @@ static void handle_key_up(SDL_Event& event) noexcept {
         case SDL_SCANCODE_ESCAPE:
             s_InputContext.button_state[static_cast<size_t>(ActionButton::Menu)] = false;
             break;
+        case SDL_SCANCODE_O:
+            s_InputContext.button_state[static_cast<size_t>(ActionButton::CycleOcclusion)] = false;
+            break;
         default: break;
     }
 }
@@ -74,6 +77,9 @@ static void handle_key_down(SDL_Event& event) noexcept {
         case SDL_SCANCODE_ESCAPE:
             s_InputContext.button_state[static_cast<size_t>(ActionButton::Menu)] = true;
         break;
+        case SDL_SCANCODE_O:
+            s_InputContext.button_state[static_cast<size_t>(ActionButton::CycleOcclusion)] = true;
+        break;
         default: break;
     }
 }
@@ -2,9 +2,12 @@
 #include "renderer.h"
 #include "util.h"
 #include "input.h"
+#include "terrain.h"
+#include "render_queue.h"
 #include <sstream>
 
-size_t load_shader(Renderer& renderer, const char* vertex_file, const char* fragment_file) noexcept;
+// An invalid handle if the files can't be read or the shader doesn't build.
+ShaderHandle load_shader(Renderer& renderer, const char* vertex_file, const char* fragment_file) noexcept;
 
 void game_step(float delta_time) noexcept;
 void game_render(Renderer& renderer, float delta_time) noexcept;
@@ -13,11 +16,19 @@ void update_player(float delta_time) noexcept;
 
 static DiggyContext Context{ true };
 
-size_t shader_id;
-size_t mesh_id;
-size_t texture_id;
+ShaderHandle terrain_shader;
+TextureHandle terrain_texture;
 size_t font_id;
 
+VoxelEntity* world = nullptr;
+RenderQueue* render_queue = nullptr;
+
+// GL state calls of the last frame, made and dropped as redundant.
+size_t state_calls_issued = 0;
+size_t state_calls_elided = 0;
+
+constexpr float DIG_REACH = 16.0f * VoxelEntity::VOXEL_SIZE;
+
 int main() {
     Renderer renderer{};
 
@@ -48,31 +59,35 @@ int main() {
         return 1;
     }
 
-    shader_id = load_shader(renderer, "vertex.glsl", "fragment.glsl");
-    if (shader_id == -1) {
+    const char* terrain_vertex_file = VoxelEntity::VERTEX_LAYOUT == VertexLayout::Packed ? "chunk_vert.glsl" : "vertex.glsl";
+    terrain_shader = load_shader(renderer, terrain_vertex_file, "fragment.glsl");
+    if (!terrain_shader.valid()) {
         return 1;
     }
 
-    texture_id = renderer.upload_texture("texture_pack.png", true);
+    auto box_vertex_src = util::read_file("box_vert.glsl");
+    auto box_fragment_src = util::read_file("box_frag.glsl");
 
-    MeshBuffer quad;
-    {
-        MeshBuilder builder{quad};
-
-        builder.add_quad({-100.0, 0.0, -100.0},
-                         { 100.0, 0.0, -100.0},
-                         {-100.0,  0.0, 100.0},
-                         { 100.0,  0.0, 100.0},
-                         {1.0, 0.0, 0.0},
-                         {0.0, 1.0, 0.0},
-                         {0.0, 0.0, 1.0},
-                         {1.0, 1.0, 1.0},
-                         {0.0, 0.0}, {1.0, 0.0},
-                         {0.0, 1.0}, {1.0, 1.0},
-                         {0.0, 1.0, 0.0});
+    if (!box_vertex_src.has_value() || !box_fragment_src.has_value()) {
+        fprintf(stderr, "Error loading box shader.\n");
+        return 1;
     }
 
-    mesh_id = renderer.upload_mesh(quad);
+    if (RendererError err = renderer.create_box_shader(box_vertex_src->c_str(), box_fragment_src->c_str()); err != RendererError::None) {
+        return 1;
+    }
+
+    terrain_texture = renderer.upload_texture("texture_pack.png", true);
+
+    RenderQueue queue{renderer};
+    render_queue = &queue;
+
+    // Seeded from world/world.info when the world was pre-generated.
+    VoxelEntity terrain{renderer};
+    terrain.set_draw_state(terrain_shader, terrain_texture);
+    world = &terrain;
+
+    Context.player.position = {0.0f, 2.0f * WorldGenerator::BASE_HEIGHT * VoxelEntity::VOXEL_SIZE, 0.0f};
 
     capture_mouse();
 
@@ -88,10 +103,15 @@ int main() {
 
         handle_events(Context);
         game_step(delta_time);
+        renderer.compact_meshes();
 
         renderer.clear();
         game_render(renderer, delta_time);
         renderer.swap_buffers();
+
+        state_calls_issued = renderer.state_calls_issued();
+        state_calls_elided = renderer.state_calls_elided();
+        renderer.reset_state_counters();
     }
 
     LOG("Exiting main loop");
@@ -143,18 +163,36 @@ void game_step(float delta_time) noexcept {
     }
 
     update_player(delta_time);
+    const vec3 eye = Context.player.position + Context.player.height;
+
+    if (button_is_just_pressed(ActionButton::CycleOcclusion)) {
+        switch (world->occlusion_culling()) {
+            case OcclusionCulling::None: world->set_occlusion_culling(OcclusionCulling::Software); break;
+            case OcclusionCulling::Software: world->set_occlusion_culling(OcclusionCulling::Queries); break;
+            case OcclusionCulling::Queries: world->set_occlusion_culling(OcclusionCulling::None); break;
+        }
+    }
+
+    if (button_is_just_pressed(ActionButton::InteractPrimary)) {
+        const vec3 forward = Context.player.orientation * vec3{0.0f, 0.0f, -1.0f};
+
+        int32_t x, y, z;
+        if (world->raycast(eye, forward, DIG_REACH, x, y, z)) {
+            world->set_voxel(x, y, z, Material::Void);
+        }
+    }
+
+    // Streamed and LOD-ed around the eye, the point render culls from.
+    world->update(eye.x, eye.y, eye.z);
 }
 
 void game_render(Renderer &renderer, float delta_time) noexcept {
-    renderer.use_shader(shader_id);
-
-    renderer.set_sampler("texture_atlas", 0, texture_id);
+    render_queue->begin(Context.view, Context.projection);
 
-    renderer.set_uniform("u_Projection", Context.projection);
-    renderer.set_uniform("u_View", Context.view);
-    renderer.set_uniform("u_Model", Context.model);
+    const vec3 eye = Context.player.position + Context.player.height;
+    world->render(*render_queue, Context.projection * Context.view, eye.x, eye.y, eye.z);
 
-    renderer.render_mesh(mesh_id);
+    render_queue->execute();
 
     renderer.batch_render_text_begin(font_id);
 
@@ -164,6 +202,19 @@ void game_render(Renderer &renderer, float delta_time) noexcept {
         debug_info << "[X, Y, Z]  - [" << Context.player.position.x << ", " << Context.player.position.y << ", " << Context.player.position.z << "]\n";
         debug_info << "Yaw, Pitch - " << Context.player.yaw << ", " << Context.player.pitch << "\n";
 
+        const VoxelEntity::CullStats& cull = world->cull_stats();
+        debug_info << "Sections   - " << cull.sections_visible << " visible, culled " << cull.regions_culled << " regions, "
+            << cull.chunks_culled << " chunks, " << cull.sections_culled << " sections, " << cull.chunks_hidden
+            << " chunks hidden, " << cull.sections_occluded << " sections occluded (" << cull.milliseconds << " ms, "
+            << cull.frustum_milliseconds << " ms frustum)\n";
+
+        constexpr const char* OCCLUSION_NAMES[] {"off", "software", "queries"};
+        debug_info << "Occlusion  - " << OCCLUSION_NAMES[static_cast<size_t>(world->occlusion_culling())]
+            << ", " << cull.chunks_queried << " chunks queried [O]\n";
+        debug_info << "Draws      - " << render_queue->packet_count() << " packets, "
+            << render_queue->state_changes() << " state changes\n";
+        debug_info << "GL State   - " << state_calls_issued << " calls, " << state_calls_elided << " redundant dropped\n";
+
         renderer.batch_render_text(debug_info.str().c_str(), 2, 2, vec3{1.0f});
     }
 
@@ -172,21 +223,21 @@ void game_render(Renderer &renderer, float delta_time) noexcept {
 
 
 
-size_t load_shader(Renderer& renderer, const char* vertex_file, const char* fragment_file) noexcept {
+ShaderHandle load_shader(Renderer& renderer, const char* vertex_file, const char* fragment_file) noexcept {
     auto vSrc = util::read_file(vertex_file);
     auto fSrc = util::read_file(fragment_file);
 
     if (!vSrc.has_value() || !fSrc.has_value()) {
-        return -1;
+        return {};
     }
 
-    size_t shader_id;
+    ShaderHandle shader;
     if (RendererError err = renderer.upload_shader(vSrc.value().c_str(),
-        fSrc.value().c_str(), shader_id);
+        fSrc.value().c_str(), shader);
             err != RendererError::None) {
-        return -1;
+        return {};
     }
 
-    return shader_id;
+    return shader;
 }
 
@@ -0,0 +1,96 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#include "mesh.h"
+
+size_t MeshBuffer::vertex_count() const noexcept {
+    return layout == VertexLayout::Packed ? packed_vertices.size() : vertices.size() / FLOATS_PER_VERTEX;
+}
+
+size_t MeshBuffer::index_count() const noexcept {
+    return shared_quad_indices ? vertex_count() / 4 * std::size(QUAD_INDICES) : indices.size();
+}
+
+MeshBuilder::MeshBuilder(MeshBuffer &target)
+    : m_Buffer{target}, m_VertexCount{static_cast<uint32_t>(target.vertex_count())} {
+
+}
+
+MeshBuilder::~MeshBuilder() {
+
+}
+
+void MeshBuilder::clear() noexcept {
+    m_Buffer.vertices.clear();
+    m_Buffer.packed_vertices.clear();
+    m_Buffer.indices.clear();
+    m_Buffer.range_count = 0;
+    m_VertexCount = 0;
+}
+
+void MeshBuilder::begin_index_range() noexcept {
+    m_Buffer.ranges[m_Buffer.range_count].first = static_cast<uint32_t>(m_Buffer.index_count());
+}
+
+void MeshBuilder::end_index_range() noexcept {
+    IndexRange& range = m_Buffer.ranges[m_Buffer.range_count++];
+    range.count = static_cast<uint32_t>(m_Buffer.index_count()) - range.first;
+}
+
+void MeshBuilder::add_vertex(vec3 position, vec3 normal, vec3 color, vec2 uv, float tile) noexcept {
+    m_Buffer.vertices.push_back(position.x);
+    m_Buffer.vertices.push_back(position.y);
+    m_Buffer.vertices.push_back(position.z);
+    m_Buffer.vertices.push_back(normal.x);
+    m_Buffer.vertices.push_back(normal.y);
+    m_Buffer.vertices.push_back(normal.z);
+    m_Buffer.vertices.push_back(color.x);
+    m_Buffer.vertices.push_back(color.y);
+    m_Buffer.vertices.push_back(color.z);
+    m_Buffer.vertices.push_back(uv.x);
+    m_Buffer.vertices.push_back(uv.y);
+    m_Buffer.vertices.push_back(tile);
+    m_VertexCount++;
+}
+
+void MeshBuilder::add_index(uint32_t index) noexcept {
+    m_Buffer.indices.push_back(index);
+}
+
+void MeshBuilder::add_triangle(vec3 position0, vec3 position1, vec3 position2, vec3 color0, vec3 color1, vec3 color2, vec2 uv0, vec2 uv1, vec2 uv2, vec3 normal) noexcept {
+    add_vertex(position0, normal, color0, uv0);
+    add_vertex(position1, normal, color1, uv1);
+    add_vertex(position2, normal, color2, uv2);
+
+    add_index(m_VertexCount-3);
+    add_index(m_VertexCount-2);
+    add_index(m_VertexCount-1);
+}
+
+void MeshBuilder::add_quad(vec3 position0, vec3 position1, vec3 position2, vec3 position3, vec3 color0, vec3 color1, vec3 color2, vec3 color3, vec2 uv0, vec2 uv1, vec2 uv2, vec2 uv3, vec3 normal, float tile) noexcept {
+    add_vertex(position0, normal, color0, uv0, tile);
+    add_vertex(position1, normal, color1, uv1, tile);
+    add_vertex(position2, normal, color2, uv2, tile);
+    add_vertex(position3, normal, color3, uv3, tile);
+
+    add_quad_indices();
+}
+
+void MeshBuilder::add_packed_quad(PackedVertex vertex0, PackedVertex vertex1, PackedVertex vertex2, PackedVertex vertex3) noexcept {
+    m_Buffer.packed_vertices.push_back(vertex0);
+    m_Buffer.packed_vertices.push_back(vertex1);
+    m_Buffer.packed_vertices.push_back(vertex2);
+    m_Buffer.packed_vertices.push_back(vertex3);
+    m_VertexCount += 4;
+
+    add_quad_indices();
+}
+
+void MeshBuilder::add_quad_indices() noexcept {
+    if (m_Buffer.shared_quad_indices) return;
+
+    for (uint32_t index : QUAD_INDICES) {
+        add_index(m_VertexCount - 4 + index);
+    }
+}
@@ -0,0 +1,702 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#include "mesher.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#define RGB(r, g, b) vec3(r / 255.0f, g / 255.0f, b / 255.0f)
+
+static MaterialData s_MaterialTable[static_cast<size_t>(Material::INVALID)] {
+    { "air", 0, RGB(0, 0, 0), 0},
+    { "dirt", 3, RGB(125, 90, 69), 2},
+    { "stone", 10, RGB(73, 82, 81), 3},
+    { "grass", 3, RGB(59, 140, 74), 1},
+    { "wood", 7, RGB(163, 83, 59), 5},
+    { "iron", 15, RGB(163, 123, 111), 12},
+    { "copper", 12, RGB(237, 142, 52), 13},
+};
+
+#undef RGB
+
+const MaterialData& get_material_data(Material material) noexcept {
+    return s_MaterialTable[static_cast<size_t>(material)];
+}
+
+// The quad spans u_axis x v_axis, chosen so that cross(u, v) is the face
+// normal; add_quad's (0,1,2)(2,1,3) winding is then counter-clockwise seen
+// from outside.
+struct FaceInfo {
+    int axis;
+    int sign;
+    int u_axis;
+    int v_axis;
+};
+
+static constexpr FaceInfo s_Faces[FACE_DIRECTION_COUNT] {
+    {0, -1, 2, 1},
+    {0, +1, 1, 2},
+    {1, -1, 0, 2},
+    {1, +1, 2, 0},
+    {2, -1, 1, 0},
+    {2, +1, 0, 1},
+};
+
+static constexpr ptrdiff_t s_PaddedStep[3] {
+    1,
+    static_cast<ptrdiff_t>(ChunkMesher::PADDED_X * ChunkMesher::PADDED_Z),
+    static_cast<ptrdiff_t>(ChunkMesher::PADDED_X),
+};
+
+static inline vec3 face_normal(const FaceInfo& face) noexcept {
+    vec3 normal{0.0f};
+    normal[face.axis] = static_cast<float>(face.sign);
+    return normal;
+}
+
+// Brightness for an AO level, 0 (fully occluded) to 3 (open); matches
+// chunk_vert.glsl.
+static inline float ao_brightness(uint32_t ao) noexcept {
+    return 0.4f + 0.2f * static_cast<float>(ao);
+}
+
+// Emits a width x height quad whose minimum corner voxel is (x, y, z). ao
+// holds 2 bits per corner in (0,0), (u,0), (0,v), (u,v) order.
+static void emit_face(MeshBuilder& builder, int x, int y, int z, FaceDirection direction,
+    Material material, int width, int height, uint8_t ao = ChunkMesher::OPEN_AO) noexcept {
+    const FaceInfo& face = s_Faces[static_cast<size_t>(direction)];
+
+    // Corners go to add_quad in (0,0), (u,0), (0,v), (u,v) order, which splits
+    // along (u,0)-(0,v). When the other diagonal is brighter, rotate to
+    // (u,0), (u,v), (0,0), (0,v): same winding, split along (0,0)-(u,v), so
+    // the AO gradient interpolates evenly.
+    static constexpr int ORDER[2][4] {{0, 1, 2, 3}, {1, 3, 0, 2}};
+    const uint32_t corner_ao[4] {
+        static_cast<uint32_t>(ao & 3u), static_cast<uint32_t>(ao >> 2 & 3u),
+        static_cast<uint32_t>(ao >> 4 & 3u), static_cast<uint32_t>(ao >> 6 & 3u),
+    };
+    const int (&order)[4] = ORDER[corner_ao[0] + corner_ao[3] > corner_ao[1] + corner_ao[2] ? 1 : 0];
+
+    if (builder.layout() == VertexLayout::Packed) {
+        uint32_t corner[4][3];
+        for (auto& c : corner) {
+            c[0] = static_cast<uint32_t>(x);
+            c[1] = static_cast<uint32_t>(y);
+            c[2] = static_cast<uint32_t>(z);
+            if (face.sign > 0) c[face.axis]++;
+        }
+        corner[1][face.u_axis] += width;
+        corner[2][face.v_axis] += height;
+        corner[3][face.u_axis] += width;
+        corner[3][face.v_axis] += height;
+
+        const uint32_t tile = get_material_data(material).atlas_tile;
+        auto pack = [&](int i) {
+            return pack_vertex(corner[i][0], corner[i][1], corner[i][2], static_cast<uint32_t>(direction),
+                corner_ao[i], PACKED_MAX_LIGHT, tile);
+        };
+        builder.add_packed_quad(pack(order[0]), pack(order[1]), pack(order[2]), pack(order[3]));
+        return;
+    }
+
+    vec3 base{static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)};
+    if (face.sign > 0) {
+        base[face.axis] += 1.0f;
+    }
+
+    vec3 u{0.0f}, v{0.0f};
+    u[face.u_axis] = static_cast<float>(width);
+    v[face.v_axis] = static_cast<float>(height);
+
+    // Tile-local UVs in voxels so the texture repeats across merged quads.
+    // Keep texture "up" pointing along +Y on the side faces. chunk_vert.glsl
+    // derives the same UVs from packed positions; keep the two in sync.
+    const bool swap_st = face.u_axis == 1;
+    auto tile_uv = [&](float s, float t) {
+        vec2 uv{s * static_cast<float>(width), t * static_cast<float>(height)};
+        if (swap_st) std::swap(uv.x, uv.y);
+        return uv;
+    };
+
+    const vec3 positions[4] {base, base + u, base + v, base + u + v};
+    const vec2 uvs[4] {tile_uv(0.0f, 0.0f), tile_uv(1.0f, 0.0f), tile_uv(0.0f, 1.0f), tile_uv(1.0f, 1.0f)};
+    vec3 colors[4];
+    for (int i = 0; i < 4; i++) {
+        colors[i] = vec3{ao_brightness(corner_ao[i])};
+    }
+
+    builder.add_quad(positions[order[0]], positions[order[1]], positions[order[2]], positions[order[3]],
+        colors[order[0]], colors[order[1]], colors[order[2]], colors[order[3]],
+        uvs[order[0]], uvs[order[1]], uvs[order[2]], uvs[order[3]],
+        face_normal(face), static_cast<float>(get_material_data(material).atlas_tile));
+}
+
+void ChunkMesher::build_padded(const ChunkNeighbourhood& chunks) noexcept {
+    std::fill(std::begin(m_Padded), std::end(m_Padded), Material::Void);
+
+    const Chunk& center = *chunks.center;
+    for (size_t y = 0; y < CHUNK_SIZE_Y; y++) {
+        for (size_t z = 0; z < CHUNK_SIZE_Z; z++) {
+            std::memcpy(&m_Padded[padded_index(1, y + 1, z + 1)], &center.voxels[Chunk::index(0, y, z)],
+                CHUNK_SIZE_X * sizeof(Material));
+        }
+    }
+
+    // Only the face slabs are needed; edge and corner voxels stay air.
+    if (const Chunk* n = chunks.neighbours[static_cast<size_t>(FaceDirection::NegX)]) {
+        for (size_t y = 0; y < CHUNK_SIZE_Y; y++)
+            for (size_t z = 0; z < CHUNK_SIZE_Z; z++)
+                m_Padded[padded_index(0, y + 1, z + 1)] = n->at(CHUNK_SIZE_X - 1, y, z);
+    }
+    if (const Chunk* n = chunks.neighbours[static_cast<size_t>(FaceDirection::PosX)]) {
+        for (size_t y = 0; y < CHUNK_SIZE_Y; y++)
+            for (size_t z = 0; z < CHUNK_SIZE_Z; z++)
+                m_Padded[padded_index(PADDED_X - 1, y + 1, z + 1)] = n->at(0, y, z);
+    }
+    if (const Chunk* n = chunks.neighbours[static_cast<size_t>(FaceDirection::NegY)]) {
+        for (size_t z = 0; z < CHUNK_SIZE_Z; z++)
+            std::memcpy(&m_Padded[padded_index(1, 0, z + 1)], &n->voxels[Chunk::index(0, CHUNK_SIZE_Y - 1, z)],
+                CHUNK_SIZE_X * sizeof(Material));
+    }
+    if (const Chunk* n = chunks.neighbours[static_cast<size_t>(FaceDirection::PosY)]) {
+        for (size_t z = 0; z < CHUNK_SIZE_Z; z++)
+            std::memcpy(&m_Padded[padded_index(1, PADDED_Y - 1, z + 1)], &n->voxels[Chunk::index(0, 0, z)],
+                CHUNK_SIZE_X * sizeof(Material));
+    }
+    if (const Chunk* n = chunks.neighbours[static_cast<size_t>(FaceDirection::NegZ)]) {
+        for (size_t y = 0; y < CHUNK_SIZE_Y; y++)
+            std::memcpy(&m_Padded[padded_index(1, y + 1, 0)], &n->voxels[Chunk::index(0, y, CHUNK_SIZE_Z - 1)],
+                CHUNK_SIZE_X * sizeof(Material));
+    }
+    if (const Chunk* n = chunks.neighbours[static_cast<size_t>(FaceDirection::PosZ)]) {
+        for (size_t y = 0; y < CHUNK_SIZE_Y; y++)
+            std::memcpy(&m_Padded[padded_index(1, y + 1, PADDED_Z - 1)], &n->voxels[Chunk::index(0, y, 0)],
+                CHUNK_SIZE_X * sizeof(Material));
+    }
+}
+
+void ChunkMesher::mesh_culled(const ChunkNeighbourhood& chunks, MeshBuilder& builder) noexcept {
+    build_padded(chunks);
+
+    for (size_t y = 0; y < CHUNK_SIZE_Y; y++) {
+        for (size_t z = 0; z < CHUNK_SIZE_Z; z++) {
+            for (size_t x = 0; x < CHUNK_SIZE_X; x++) {
+                const size_t index = padded_index(x + 1, y + 1, z + 1);
+                const Material material = m_Padded[index];
+                if (!material_is_solid(material)) continue;
+
+                for (size_t d = 0; d < FACE_DIRECTION_COUNT; d++) {
+                    const FaceInfo& face = s_Faces[d];
+                    const Material neighbour = m_Padded[index + face.sign * s_PaddedStep[face.axis]];
+                    if (material_is_solid(neighbour)) continue;
+
+                    emit_face(builder, static_cast<int>(x), static_cast<int>(y), static_cast<int>(z),
+                        static_cast<FaceDirection>(d), material, 1, 1);
+                }
+            }
+        }
+    }
+}
+
+void ChunkMesher::mesh_greedy(const ChunkNeighbourhood& chunks, MeshBuilder& builder) noexcept {
+    build_padded(chunks);
+
+    for (size_t d = 0; d < FACE_DIRECTION_COUNT; d++) {
+        const FaceInfo& face = s_Faces[d];
+        const ptrdiff_t neighbour_offset = face.sign * s_PaddedStep[face.axis];
+
+        for (size_t slice = 0; slice < SLICE_SIZE; slice++) {
+            // Gather the visible faces of this slice, indexed [v][u].
+            size_t position[3];
+            position[face.axis] = slice + 1;
+            for (size_t v = 0; v < SLICE_SIZE; v++) {
+                position[face.v_axis] = v + 1;
+                for (size_t u = 0; u < SLICE_SIZE; u++) {
+                    position[face.u_axis] = u + 1;
+
+                    const size_t index = padded_index(position[0], position[1], position[2]);
+                    const Material material = m_Padded[index];
+                    const bool visible = material_is_solid(material) && !material_is_solid(m_Padded[index + neighbour_offset]);
+                    m_FaceMask[u + SLICE_SIZE * v] = visible ? material : Material::Void;
+                }
+            }
+
+            // Grow each face along u, then along v while the whole row matches,
+            // and clear what was consumed.
+            for (size_t v = 0; v < SLICE_SIZE; v++) {
+                for (size_t u = 0; u < SLICE_SIZE;) {
+                    const Material material = m_FaceMask[u + SLICE_SIZE * v];
+                    if (material == Material::Void) {
+                        u++;
+                        continue;
+                    }
+
+                    size_t width = 1;
+                    while (u + width < SLICE_SIZE && m_FaceMask[u + width + SLICE_SIZE * v] == material) {
+                        width++;
+                    }
+
+                    size_t height = 1;
+                    for (; v + height < SLICE_SIZE; height++) {
+                        const Material* row = &m_FaceMask[u + SLICE_SIZE * (v + height)];
+                        if (std::any_of(row, row + width, [material](Material m) { return m != material; })) break;
+                    }
+
+                    for (size_t h = 0; h < height; h++) {
+                        std::fill_n(&m_FaceMask[u + SLICE_SIZE * (v + h)], width, Material::Void);
+                    }
+
+                    int corner[3];
+                    corner[face.axis] = static_cast<int>(slice);
+                    corner[face.u_axis] = static_cast<int>(u);
+                    corner[face.v_axis] = static_cast<int>(v);
+                    emit_face(builder, corner[0], corner[1], corner[2], static_cast<FaceDirection>(d), material,
+                        static_cast<int>(width), static_cast<int>(height));
+
+                    u += width;
+                }
+            }
+        }
+    }
+}
+
+// Step in m_Columns[axis] per unit of each coordinate; a column is indexed
+// by the two coordinates other than its own axis, offset by one for the ring.
+static constexpr size_t s_ColumnStep[3][3] {
+    {0, ChunkMesher::COLUMN_STRIDE, 1},
+    {1, 0, ChunkMesher::COLUMN_STRIDE},
+    {1, ChunkMesher::COLUMN_STRIDE, 0},
+};
+
+static constexpr size_t s_VoxelStep[3] {
+    Chunk::index(1, 0, 0),
+    Chunk::index(0, 1, 0),
+    Chunk::index(0, 0, 1),
+};
+
+// In-place 32x32 bit matrix transpose: bit c of m[r] becomes bit r of m[c].
+static void transpose_32x32(uint32_t m[32]) noexcept {
+    uint32_t mask = 0x0000FFFF;
+    for (int j = 16; j != 0; j >>= 1, mask ^= mask << j) {
+        for (int k = 0; k < 32; k = (k + j + 1) & ~j) {
+            const uint32_t t = ((m[k] >> j) ^ m[k + j]) & mask;
+            m[k] ^= t << j;
+            m[k + j] ^= t;
+        }
+    }
+}
+
+static inline uint64_t solid_bit(const Chunk* chunk, size_t x, size_t y, size_t z) noexcept {
+    return chunk && material_is_solid(chunk->at(x, y, z)) ? 1 : 0;
+}
+
+// Solid bits of 32 consecutive voxels, four 16-bit voxels per 64-bit word:
+// the high bit of each lane is set iff the lane is non-zero (air is 0), then
+// the multiply gathers the four lane bits into bits 45..48. Lane order
+// assumes a little-endian host.
+static_assert(sizeof(Material) == 2 && static_cast<block_t>(Material::Void) == 0);
+static inline uint32_t solid_row_bits(const Material* row) noexcept {
+    constexpr uint64_t LOW = 0x7FFF7FFF7FFF7FFFull;
+    constexpr uint64_t HIGH = 0x8000800080008000ull;
+    constexpr uint64_t GATHER = 0x0000200040008001ull;
+
+    uint32_t bits = 0;
+    for (size_t x = 0; x < ChunkMesher::SLICE_SIZE; x += 4) {
+        uint64_t lanes;
+        std::memcpy(&lanes, row + x, sizeof(lanes));
+        const uint64_t nonzero = (((lanes & LOW) + LOW) | lanes) & HIGH;
+        bits |= static_cast<uint32_t>(((nonzero >> 15) * GATHER) >> 45 & 0xF) << x;
+    }
+    return bits;
+}
+
+void ChunkMesher::build_columns(const ChunkNeighbourhood& chunks) noexcept {
+    constexpr size_t S = SLICE_SIZE;
+    constexpr size_t P = COLUMN_STRIDE;
+    const Chunk& center = *chunks.center;
+    const Chunk* const* n = chunks.neighbours;
+
+    // Solid bits of every x row, [y][z]; the y and z columns are transposes.
+    uint32_t rows[S][S];
+    for (size_t y = 0; y < S; y++) {
+        for (size_t z = 0; z < S; z++) {
+            rows[y][z] = solid_row_bits(&center.voxels[Chunk::index(0, y, z)]);
+        }
+    }
+
+    // Bit 0 and bit S + 1 of each column hold the neighbouring chunks' voxels.
+    for (size_t y = 0; y < S; y++) {
+        for (size_t z = 0; z < S; z++) {
+            m_Columns[0][(z + 1) + P * (y + 1)] = static_cast<uint64_t>(rows[y][z]) << 1
+                | solid_bit(n[static_cast<size_t>(FaceDirection::NegX)], S - 1, y, z)
+                | solid_bit(n[static_cast<size_t>(FaceDirection::PosX)], 0, y, z) << (S + 1);
+        }
+    }
+
+    uint32_t slice[S];
+    for (size_t z = 0; z < S; z++) {
+        for (size_t y = 0; y < S; y++) slice[y] = rows[y][z];
+        transpose_32x32(slice);
+        for (size_t x = 0; x < S; x++) {
+            m_Columns[1][(x + 1) + P * (z + 1)] = static_cast<uint64_t>(slice[x]) << 1
+                | solid_bit(n[static_cast<size_t>(FaceDirection::NegY)], x, S - 1, z)
+                | solid_bit(n[static_cast<size_t>(FaceDirection::PosY)], x, 0, z) << (S + 1);
+        }
+    }
+
+    for (size_t y = 0; y < S; y++) {
+        for (size_t z = 0; z < S; z++) slice[z] = rows[y][z];
+        transpose_32x32(slice);
+        for (size_t x = 0; x < S; x++) {
+            m_Columns[2][(x + 1) + P * (y + 1)] = static_cast<uint64_t>(slice[x]) << 1
+                | solid_bit(n[static_cast<size_t>(FaceDirection::NegZ)], x, y, S - 1)
+                | solid_bit(n[static_cast<size_t>(FaceDirection::PosZ)], x, y, 0) << (S + 1);
+        }
+    }
+
+    // The ring of columns just outside the chunk, taken from the face
+    // neighbours, is only read for AO. Its corners and end bits would need
+    // the diagonal chunks and stay empty.
+    for (int axis = 0; axis < 3; axis++) {
+        for (int side_axis = 0; side_axis < 3; side_axis++) {
+            if (side_axis == axis) continue;
+            const int along_axis = 3 - axis - side_axis;
+
+            for (int high = 0; high < 2; high++) {
+                const Chunk* neighbour = n[2 * side_axis + high];
+                const size_t ring = high ? S + 1 : 0;
+
+                for (size_t t = 0; t < S; t++) {
+                    uint64_t bits = 0;
+                    if (neighbour) {
+                        size_t p[3];
+                        p[side_axis] = high ? 0 : S - 1;
+                        p[along_axis] = t;
+                        for (size_t i = 0; i < S; i++) {
+                            p[axis] = i;
+                            bits |= solid_bit(neighbour, p[0], p[1], p[2]) << (i + 1);
+                        }
+                    }
+                    m_Columns[axis][ring * s_ColumnStep[axis][side_axis] + (t + 1) * s_ColumnStep[axis][along_axis]] = bits;
+                }
+            }
+        }
+    }
+}
+
+void ChunkMesher::mesh_binary(const ChunkNeighbourhood& chunks, MeshBuilder& builder) noexcept {
+    build_columns(chunks);
+
+    constexpr size_t lo[3] {0, 0, 0};
+    constexpr size_t hi[3] {SLICE_SIZE, SLICE_SIZE, SLICE_SIZE};
+    emit_binary(*chunks.center, lo, hi, builder);
+}
+
+void ChunkMesher::mesh_sections(const ChunkNeighbourhood& chunks, uint32_t section_mask,
+    MeshBuffer (&buffers)[SECTION_COUNT]) noexcept {
+    build_columns(chunks);
+
+    for (size_t y = 0; y < SECTIONS_Y; y++) {
+        for (size_t z = 0; z < SECTIONS_Z; z++) {
+            for (size_t x = 0; x < SECTIONS_X; x++) {
+                const size_t section = section_index(x * SECTION_SIZE, y * SECTION_SIZE, z * SECTION_SIZE);
+                if (!(section_mask & (1u << section))) continue;
+
+                const size_t lo[3] {x * SECTION_SIZE, y * SECTION_SIZE, z * SECTION_SIZE};
+                const size_t hi[3] {lo[0] + SECTION_SIZE, lo[1] + SECTION_SIZE, lo[2] + SECTION_SIZE};
+
+                MeshBuilder builder{buffers[section]};
+                builder.clear();
+                emit_binary(*chunks.center, lo, hi, builder);
+            }
+        }
+    }
+}
+
+// Bits [lo, hi) of a slice row or column.
+static inline uint32_t bit_range(size_t lo, size_t hi) noexcept {
+    const uint32_t below_hi = hi >= 32 ? ~uint32_t{0} : (uint32_t{1} << hi) - 1;
+    return below_hi & ~((uint32_t{1} << lo) - 1);
+}
+
+void ChunkMesher::emit_binary(const Chunk& center, const size_t lo[3], const size_t hi[3], MeshBuilder& builder) noexcept {
+    for (size_t d = 0; d < FACE_DIRECTION_COUNT; d++) {
+        const FaceInfo& face = s_Faces[d];
+        uint32_t used_slices[MATERIAL_COUNT]{};
+        builder.begin_index_range();
+
+        // A face is visible where a solid bit's neighbour along the axis is
+        // clear; drop the padding bits to get one bit per slice.
+        const ptrdiff_t column_u = static_cast<ptrdiff_t>(s_ColumnStep[face.axis][face.u_axis]);
+        const ptrdiff_t column_v = static_cast<ptrdiff_t>(s_ColumnStep[face.axis][face.v_axis]);
+        const uint64_t* columns = m_Columns[face.axis] + column_u + column_v;
+
+        const uint32_t slice_bits = bit_range(lo[face.axis], hi[face.axis]);
+
+        for (size_t v = lo[face.v_axis]; v < hi[face.v_axis]; v++) {
+            for (size_t u = lo[face.u_axis]; u < hi[face.u_axis]; u++) {
+                const uint64_t* column_ptr = columns + static_cast<ptrdiff_t>(u) * column_u + static_cast<ptrdiff_t>(v) * column_v;
+                const uint64_t column = *column_ptr;
+                const uint64_t visible = face.sign > 0 ? column & ~(column >> 1) : column & ~(column << 1);
+                uint32_t faces = static_cast<uint32_t>(visible >> 1) & slice_bits;
+                if (!faces) continue;
+
+                // AO for all 32 slices at once. For every corner, the two side
+                // voxels and the diagonal voxel in the layer in front of the
+                // face, shifted so that bit i lines up with the face in slice i.
+                // Then ao = 3 - (side1 + side2 + corner), or 0 when both sides
+                // are solid, computed as 2-bit values spread over two words.
+                uint32_t ao_high[4], ao_low[4];
+                if (m_AmbientOcclusion) {
+                    auto front = [&](ptrdiff_t du, ptrdiff_t dv) noexcept {
+                        const uint64_t c = column_ptr[du * column_u + dv * column_v];
+                        return static_cast<uint32_t>(face.sign > 0 ? c >> 2 : c);
+                    };
+                    const uint32_t side_u[2] {front(-1, 0), front(1, 0)};
+                    const uint32_t side_v[2] {front(0, -1), front(0, 1)};
+                    const uint32_t diagonal[4] {front(-1, -1), front(1, -1), front(-1, 1), front(1, 1)};
+
+                    for (int k = 0; k < 4; k++) {
+                        const uint32_t a = side_u[k & 1];
+                        const uint32_t b = side_v[k >> 1];
+                        const uint32_t c = diagonal[k];
+                        const uint32_t both_sides = a & b;
+                        ao_high[k] = ~(both_sides | (a & c) | (b & c)) & ~both_sides;
+                        ao_low[k] = ~(a ^ b ^ c) & ~both_sides;
+                    }
+                }
+
+                while (faces) {
+                    const int slice = std::countr_zero(faces);
+                    faces &= faces - 1;
+
+                    uint8_t ao = OPEN_AO;
+                    if (m_AmbientOcclusion) {
+                        ao = 0;
+                        for (int k = 0; k < 4; k++) {
+                            ao |= static_cast<uint8_t>(((ao_high[k] >> slice & 1u) << 1 | (ao_low[k] >> slice & 1u)) << (2 * k));
+                        }
+                    }
+                    m_FaceAO[slice][u][v] = ao;
+
+                    const size_t voxel = u * s_VoxelStep[face.u_axis] + v * s_VoxelStep[face.v_axis]
+                        + slice * s_VoxelStep[face.axis];
+                    const size_t material = static_cast<size_t>(center.voxels[voxel]);
+                    m_Planes[material][slice][u] |= uint32_t{1} << v;
+                    used_slices[material] |= uint32_t{1} << slice;
+                }
+            }
+        }
+
+        for (size_t material = 0; material < MATERIAL_COUNT; material++) {
+            for (uint32_t slices = used_slices[material]; slices; slices &= slices - 1) {
+                const int slice = std::countr_zero(slices);
+                uint32_t (&rows)[SLICE_SIZE] = m_Planes[material][slice];
+
+                for (size_t u = lo[face.u_axis]; u < hi[face.u_axis]; u++) {
+                    while (rows[u]) {
+                        // Faces only merge with equal AO on all four corners.
+                        const int v = std::countr_zero(rows[u]);
+                        const uint8_t ao = m_FaceAO[slice][u][v];
+                        const uint8_t* column_ao = m_FaceAO[slice][u];
+
+                        int height = std::countr_one(rows[u] >> v);
+                        height = static_cast<int>(std::find_if(column_ao + v + 1, column_ao + v + height,
+                            [ao](uint8_t other) { return other != ao; }) - (column_ao + v));
+
+                        const uint32_t span = (height == 32 ? ~uint32_t{0} : (uint32_t{1} << height) - 1) << v;
+                        rows[u] &= ~span;
+
+                        size_t width = 1;
+                        while (u + width < hi[face.u_axis] && (rows[u + width] & span) == span
+                            && std::all_of(m_FaceAO[slice][u + width] + v, m_FaceAO[slice][u + width] + v + height,
+                                [ao](uint8_t other) { return other == ao; })) {
+                            rows[u + width] &= ~span;
+                            width++;
+                        }
+
+                        int corner[3];
+                        corner[face.axis] = slice;
+                        corner[face.u_axis] = static_cast<int>(u);
+                        corner[face.v_axis] = v;
+                        emit_face(builder, corner[0], corner[1], corner[2], static_cast<FaceDirection>(d),
+                            static_cast<Material>(material), static_cast<int>(width), height, ao);
+                    }
+                }
+            }
+        }
+
+        builder.end_index_range();
+    }
+}
+
+void ChunkMesher::mesh(const ChunkNeighbourhood& chunks, MeshBuilder& builder, MeshingMode mode) noexcept {
+    switch (mode) {
+        case MeshingMode::Culled:
+            mesh_culled(chunks, builder);
+            break;
+        case MeshingMode::Greedy:
+            mesh_greedy(chunks, builder);
+            break;
+        case MeshingMode::Binary:
+            mesh_binary(chunks, builder);
+            break;
+    }
+}
+
+uint64_t ChunkMesher::face_connectivity(const Chunk& chunk) noexcept {
+    static_assert(CHUNK_VOLUME <= UINT16_MAX + 1);
+    // Per axis x, y, z; Chunk::index runs x, then z, then y.
+    constexpr size_t SIZE[3] {CHUNK_SIZE_X, CHUNK_SIZE_Y, CHUNK_SIZE_Z};
+    static constexpr size_t STEP[3] {1, CHUNK_SIZE_X * CHUNK_SIZE_Z, CHUNK_SIZE_X};
+    auto position_of = [](size_t index, size_t (&position)[3]) {
+        position[0] = index % CHUNK_SIZE_X;
+        position[1] = index / STEP[1];
+        position[2] = index / CHUNK_SIZE_X % CHUNK_SIZE_Z;
+    };
+    auto flood = [this](size_t index) { m_Flooded[index / 64] |= uint64_t{1} << index % 64; };
+    auto open = [this, &chunk](size_t index) {
+        return !material_is_solid(chunk.voxels[index]) && !(m_Flooded[index / 64] >> index % 64 & 1);
+    };
+
+    std::memset(m_Flooded, 0, sizeof(m_Flooded));
+    uint64_t connections = 0;
+
+    for (size_t seed = 0; seed < CHUNK_VOLUME && connections != ALL_FACE_CONNECTIONS; seed++) {
+        if (!open(seed)) continue;
+
+        size_t position[3];
+        position_of(seed, position);
+        bool on_border = false;
+        for (int axis = 0; axis < 3; axis++) {
+            on_border |= position[axis] == 0 || position[axis] == SIZE[axis] - 1;
+        }
+        if (!on_border) continue;
+
+        flood(seed);
+        m_FloodQueue[0] = static_cast<uint16_t>(seed);
+        size_t head = 0, tail = 1;
+        uint32_t faces = 0;
+
+        while (head < tail) {
+            const size_t index = m_FloodQueue[head++];
+            position_of(index, position);
+
+            for (int axis = 0; axis < 3; axis++) {
+                for (int high = 0; high < 2; high++) {
+                    if (position[axis] == (high ? SIZE[axis] - 1 : 0)) {
+                        faces |= 1u << (2 * axis + high);
+                        continue;
+                    }
+
+                    const size_t next = high ? index + STEP[axis] : index - STEP[axis];
+                    if (!open(next)) continue;
+                    flood(next);
+                    m_FloodQueue[tail++] = static_cast<uint16_t>(next);
+                }
+            }
+        }
+
+        for (uint32_t a = faces; a; a &= a - 1) {
+            for (uint32_t b = faces; b; b &= b - 1) {
+                connections |= face_connection_bit(std::countr_zero(a), std::countr_zero(b));
+            }
+        }
+    }
+    return connections;
+}
+
+ChunkOccluder chunk_occluder(const Chunk& chunk) noexcept {
+    ChunkOccluder occluder;
+
+    for (size_t cz = 0; cz < OCCLUDER_COLUMNS_Z; cz++) {
+        for (size_t cx = 0; cx < OCCLUDER_COLUMNS_X; cx++) {
+            size_t run_from = 0;
+            for (size_t y = 0; y <= CHUNK_SIZE_Y; y++) {
+                bool solid = y < CHUNK_SIZE_Y;
+                for (size_t z = cz * OCCLUDER_BLOCK; solid && z < (cz + 1) * OCCLUDER_BLOCK; z++) {
+                    for (size_t x = cx * OCCLUDER_BLOCK; solid && x < (cx + 1) * OCCLUDER_BLOCK; x++) {
+                        solid = material_is_solid(chunk.at(x, y, z));
+                    }
+                }
+                if (solid) continue;
+
+                if (y - run_from > static_cast<size_t>(occluder.to[cz][cx] - occluder.from[cz][cx])) {
+                    occluder.from[cz][cx] = static_cast<uint8_t>(run_from);
+                    occluder.to[cz][cx] = static_cast<uint8_t>(y);
+                }
+                run_from = y + 1;
+            }
+        }
+    }
+    return occluder;
+}
+
+// downsample_chunk over the blocks in [from, to), voxel bounds that are
+// multiples of factor, as x, y, z.
+static void downsample_blocks(const Chunk& chunk, size_t factor, const size_t from[3], const size_t to[3], Chunk& out) noexcept {
+    constexpr size_t MATERIAL_COUNT = ChunkMesher::MATERIAL_COUNT;
+    const size_t block_volume = factor * factor * factor;
+
+    for (size_t by = from[1]; by < to[1]; by += factor) {
+        for (size_t bz = from[2]; bz < to[2]; bz += factor) {
+            for (size_t bx = from[0]; bx < to[0]; bx += factor) {
+                size_t solid = 0;
+                size_t top_counts[MATERIAL_COUNT]{};
+                bool top_found = false;
+
+                for (size_t y = by + factor; y-- > by;) {
+                    size_t layer_counts[MATERIAL_COUNT]{};
+                    for (size_t z = bz; z < bz + factor; z++) {
+                        for (size_t x = bx; x < bx + factor; x++) {
+                            layer_counts[static_cast<size_t>(chunk.at(x, y, z))]++;
+                        }
+                    }
+
+                    const size_t layer_solid = factor * factor - layer_counts[static_cast<size_t>(Material::Void)];
+                    solid += layer_solid;
+                    if (!top_found && layer_solid) {
+                        std::copy(std::begin(layer_counts), std::end(layer_counts), top_counts);
+                        top_found = true;
+                    }
+                }
+
+                Material material = Material::Void;
+                if (solid * 2 >= block_volume) {
+                    top_counts[static_cast<size_t>(Material::Void)] = 0;
+                    material = static_cast<Material>(std::max_element(std::begin(top_counts), std::end(top_counts)) - std::begin(top_counts));
+                }
+
+                for (size_t y = by; y < by + factor; y++) {
+                    for (size_t z = bz; z < bz + factor; z++) {
+                        std::fill_n(&out.voxels[Chunk::index(bx, y, z)], factor, material);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void downsample_chunk(const Chunk& chunk, size_t factor, Chunk& out) noexcept {
+    constexpr size_t FROM[3] {0, 0, 0};
+    constexpr size_t TO[3] {CHUNK_SIZE_X, CHUNK_SIZE_Y, CHUNK_SIZE_Z};
+    downsample_blocks(chunk, factor, FROM, TO, out);
+}
+
+void downsample_chunk_face(const Chunk& chunk, size_t factor, FaceDirection face, Chunk& out) noexcept {
+    const size_t axis = static_cast<size_t>(face) / 2;
+    const bool high = static_cast<size_t>(face) % 2 == 1;
+
+    size_t from[3] {0, 0, 0};
+    size_t to[3] {CHUNK_SIZE_X, CHUNK_SIZE_Y, CHUNK_SIZE_Z};
+    if (high) {
+        from[axis] = to[axis] - factor;
+    }
+    else {
+        to[axis] = factor;
+    }
+    downsample_blocks(chunk, factor, from, to, out);
+}
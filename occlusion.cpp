@@ -0,0 +1,237 @@
+//
+// Created by ctlf on 10/18/26.
+//
+#include "occlusion.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+OcclusionBuffer::OcclusionBuffer() {
+    for (int level = 0; level < LEVEL_COUNT; level++) {
+        m_Levels[level].assign(static_cast<size_t>(WIDTH >> level) * (HEIGHT >> level), 1.0f);
+    }
+}
+
+void OcclusionBuffer::begin(const mat4& view_projection, vec3 eye) noexcept {
+    m_ViewProjection = view_projection;
+    m_Eye = eye;
+    m_Quads.clear();
+}
+
+bool OcclusionBuffer::to_screen(const vec4& clip, vec3& screen) noexcept {
+    if (clip.z < -clip.w || clip.w <= 0.0f) return false;
+
+    const float inverse_w = 1.0f / clip.w;
+    screen = {
+        (clip.x * inverse_w * 0.5f + 0.5f) * WIDTH,
+        (clip.y * inverse_w * 0.5f + 0.5f) * HEIGHT,
+        clip.z * inverse_w * 0.5f + 0.5f,
+    };
+    return true;
+}
+
+void OcclusionBuffer::add_occluder(vec3 min, vec3 max) {
+    for (int axis = 0; axis < 3; axis++) {
+        const int u_axis = (axis + 1) % 3;
+        const int v_axis = (axis + 2) % 3;
+
+        for (int high = 0; high < 2; high++) {
+            if (high ? m_Eye[axis] <= max[axis] : m_Eye[axis] >= min[axis]) continue;
+
+            // Around the face: (0, 0), (1, 0), (1, 1), (0, 1) in u and v.
+            constexpr int U[4] {0, 1, 1, 0};
+            constexpr int V[4] {0, 0, 1, 1};
+            Quad quad;
+            bool in_front = true;
+            for (int i = 0; i < 4; i++) {
+                vec3 corner;
+                corner[axis] = high ? max[axis] : min[axis];
+                corner[u_axis] = U[i] ? max[u_axis] : min[u_axis];
+                corner[v_axis] = V[i] ? max[v_axis] : min[v_axis];
+                in_front &= to_screen(m_ViewProjection * vec4{corner, 1.0f}, quad.corners[i]);
+            }
+            if (!in_front) continue;
+
+            vec3* c = quad.corners;
+            const float area = (c[2].x - c[0].x) * (c[3].y - c[1].y) - (c[2].y - c[0].y) * (c[3].x - c[1].x);
+            if (std::abs(area) < 1e-3f) continue;
+            if (area < 0.0f) std::swap(c[1], c[3]);
+
+            const float min_x = std::min({c[0].x, c[1].x, c[2].x, c[3].x});
+            const float max_x = std::max({c[0].x, c[1].x, c[2].x, c[3].x});
+            const float min_y = std::min({c[0].y, c[1].y, c[2].y, c[3].y});
+            const float max_y = std::max({c[0].y, c[1].y, c[2].y, c[3].y});
+            if (max_x < 0.0f || min_x >= WIDTH || max_y < 0.0f || min_y >= HEIGHT) continue;
+
+            m_Quads.push_back(quad);
+        }
+    }
+}
+
+void OcclusionBuffer::rasterize(ThreadPool& pool) {
+    for (std::vector<uint32_t>& bin : m_Bins) {
+        bin.clear();
+    }
+
+    for (size_t i = 0; i < m_Quads.size(); i++) {
+        const vec3* c = m_Quads[i].corners;
+        const float min_x = std::min({c[0].x, c[1].x, c[2].x, c[3].x});
+        const float max_x = std::max({c[0].x, c[1].x, c[2].x, c[3].x});
+        const float min_y = std::min({c[0].y, c[1].y, c[2].y, c[3].y});
+        const float max_y = std::max({c[0].y, c[1].y, c[2].y, c[3].y});
+
+        const int tile_x0 = std::clamp(static_cast<int>(min_x) / TILE_WIDTH, 0, TILES_X - 1);
+        const int tile_x1 = std::clamp(static_cast<int>(max_x) / TILE_WIDTH, 0, TILES_X - 1);
+        const int tile_y0 = std::clamp(static_cast<int>(min_y) / TILE_HEIGHT, 0, TILES_Y - 1);
+        const int tile_y1 = std::clamp(static_cast<int>(max_y) / TILE_HEIGHT, 0, TILES_Y - 1);
+        for (int ty = tile_y0; ty <= tile_y1; ty++) {
+            for (int tx = tile_x0; tx <= tile_x1; tx++) {
+                m_Bins[tx + TILES_X * ty].push_back(static_cast<uint32_t>(i));
+            }
+        }
+    }
+
+    pool.parallel_for_front(TILE_COUNT, [this](size_t tile) { rasterize_tile(tile); });
+    build_hierarchy();
+}
+
+// Edge functions and depth are planes in x and y, evaluated at pixel centers.
+// A pixel is covered completely when every edge function, less how much it
+// can drop within half a pixel, is still positive there; it then takes the
+// quad's depth plus how much that can rise within half a pixel, if nearer.
+void OcclusionBuffer::rasterize_tile(size_t tile) noexcept {
+    const int tile_x = static_cast<int>(tile % TILES_X) * TILE_WIDTH;
+    const int tile_y = static_cast<int>(tile / TILES_X) * TILE_HEIGHT;
+    float* depth = m_Levels[0].data();
+
+    for (int y = tile_y; y < tile_y + TILE_HEIGHT; y++) {
+        std::fill_n(depth + y * WIDTH + tile_x, TILE_WIDTH, 1.0f);
+    }
+
+    for (const uint32_t index : m_Bins[tile]) {
+        const vec3* c = m_Quads[index].corners;
+
+        // Edge i runs from corner i to the next: e = ex * x + ey * y + e0,
+        // positive inside.
+        float ex[4], ey[4], e0[4];
+        for (int i = 0; i < 4; i++) {
+            const vec3& p = c[i];
+            const vec3& q = c[(i + 1) % 4];
+            ex[i] = p.y - q.y;
+            ey[i] = q.x - p.x;
+            e0[i] = -(ex[i] * p.x + ey[i] * p.y) - 0.5f * (std::abs(ex[i]) + std::abs(ey[i]));
+        }
+
+        // The face is planar, so corners 0, 1 and 3 give its depth plane.
+        const vec3 du = c[1] - c[0];
+        const vec3 dv = c[3] - c[0];
+        const float determinant = du.x * dv.y - du.y * dv.x;
+        if (std::abs(determinant) < 1e-6f) continue;
+        const float zx = (du.z * dv.y - dv.z * du.y) / determinant;
+        const float zy = (dv.z * du.x - du.z * dv.x) / determinant;
+        const float z0 = c[0].z - zx * c[0].x - zy * c[0].y + 0.5f * (std::abs(zx) + std::abs(zy));
+
+        const int x0 = std::max(tile_x, static_cast<int>(std::floor(std::min({c[0].x, c[1].x, c[2].x, c[3].x}))));
+        const int x1 = std::min(tile_x + TILE_WIDTH - 1, static_cast<int>(std::floor(std::max({c[0].x, c[1].x, c[2].x, c[3].x}))));
+        const int y0 = std::max(tile_y, static_cast<int>(std::floor(std::min({c[0].y, c[1].y, c[2].y, c[3].y}))));
+        const int y1 = std::min(tile_y + TILE_HEIGHT - 1, static_cast<int>(std::floor(std::max({c[0].y, c[1].y, c[2].y, c[3].y}))));
+
+        for (int y = y0; y <= y1; y++) {
+            const float py = static_cast<float>(y) + 0.5f;
+            float row_e[4];
+            for (int i = 0; i < 4; i++) {
+                row_e[i] = ey[i] * py + e0[i];
+            }
+            const float row_z = zy * py + z0;
+            float* row = depth + y * WIDTH;
+
+#ifdef __AVX__
+            const __m256 offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+            const __m256 zero = _mm256_setzero_ps();
+            for (int x = x0 & ~7; x <= x1; x += 8) {
+                const __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), offsets);
+                __m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(ex[0]), px), _mm256_set1_ps(row_e[0])), zero, _CMP_GE_OQ);
+                for (int i = 1; i < 4; i++) {
+                    const __m256 edge = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(ex[i]), px), _mm256_set1_ps(row_e[i]));
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(edge, zero, _CMP_GE_OQ));
+                }
+                if (_mm256_movemask_ps(inside) == 0) continue;
+
+                const __m256 z = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(zx), px), _mm256_set1_ps(row_z));
+                const __m256 current = _mm256_loadu_ps(row + x);
+                _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_min_ps(current, z), inside));
+            }
+#else
+            for (int x = x0; x <= x1; x++) {
+                const float px = static_cast<float>(x) + 0.5f;
+                bool inside = true;
+                for (int i = 0; i < 4; i++) {
+                    inside &= ex[i] * px + row_e[i] >= 0.0f;
+                }
+                if (inside) {
+                    row[x] = std::min(row[x], zx * px + row_z);
+                }
+            }
+#endif
+        }
+    }
+}
+
+void OcclusionBuffer::build_hierarchy() noexcept {
+    for (int level = 1; level < LEVEL_COUNT; level++) {
+        const int width = WIDTH >> level;
+        const int height = HEIGHT >> level;
+        const float* finer = m_Levels[level - 1].data();
+        float* coarser = m_Levels[level].data();
+
+        for (int y = 0; y < height; y++) {
+            const float* rows[2] {finer + 2 * y * (2 * width), finer + (2 * y + 1) * (2 * width)};
+            for (int x = 0; x < width; x++) {
+                coarser[x + y * width] = std::max({rows[0][2 * x], rows[0][2 * x + 1], rows[1][2 * x], rows[1][2 * x + 1]});
+            }
+        }
+    }
+}
+
+bool OcclusionBuffer::is_occluded(vec3 min, vec3 max) const noexcept {
+    float min_x = WIDTH, max_x = 0.0f, min_y = HEIGHT, max_y = 0.0f;
+    float nearest = 1.0f;
+
+    for (int i = 0; i < 8; i++) {
+        const vec3 corner{i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z};
+        vec3 screen;
+        if (!to_screen(m_ViewProjection * vec4{corner, 1.0f}, screen)) return false;
+
+        min_x = std::min(min_x, screen.x);
+        max_x = std::max(max_x, screen.x);
+        min_y = std::min(min_y, screen.y);
+        max_y = std::max(max_y, screen.y);
+        nearest = std::min(nearest, screen.z);
+    }
+
+    // Every pixel the box touches, even partly.
+    const int x0 = std::max(0, static_cast<int>(std::floor(min_x)));
+    const int x1 = std::min(WIDTH - 1, static_cast<int>(std::floor(max_x)));
+    const int y0 = std::max(0, static_cast<int>(std::floor(min_y)));
+    const int y1 = std::min(HEIGHT - 1, static_cast<int>(std::floor(max_y)));
+    if (x0 > x1 || y0 > y1) return false;
+
+    // The finest level where the box spans at most four texels per axis.
+    int level = 0;
+    while (level < LEVEL_COUNT - 1 && ((x1 >> level) - (x0 >> level) >= 4 || (y1 >> level) - (y0 >> level) >= 4)) {
+        level++;
+    }
+
+    const int width = WIDTH >> level;
+    const float* depth = m_Levels[level].data();
+    for (int y = y0 >> level; y <= y1 >> level; y++) {
+        for (int x = x0 >> level; x <= x1 >> level; x++) {
+            if (depth[x + y * width] >= nearest) return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,117 @@
+//
+// Created by ctlf on 10/18/26.
+//
+#include "render_queue.h"
+
+#include <algorithm>
+#include <bit>
+
+static uint64_t key_field(size_t value, int bits) noexcept {
+    return static_cast<uint64_t>(value) & ((uint64_t{1} << bits) - 1);
+}
+
+void RenderQueue::begin(const mat4& view, const mat4& projection) noexcept {
+    m_View = view;
+    m_Projection = projection;
+    m_Packets.clear();
+    m_Entries.clear();
+}
+
+void RenderQueue::add(RenderLayer layer, ShaderHandle shader, TextureHandle texture, MeshHandle mesh, uint32_t range_mask,
+    vec4 origin, vec3 center, size_t query_id) {
+    // Non-negative floats order the same as their bits.
+    const float depth = std::max(0.0f, -(m_View * vec4{center, 1.0f}).z);
+    const uint64_t depth_bits = std::bit_cast<uint32_t>(depth);
+
+    const uint64_t state = key_field(shader.index, SHADER_BITS) << (TEXTURE_BITS + VERTEX_ARRAY_BITS)
+        | key_field(texture.index, TEXTURE_BITS) << VERTEX_ARRAY_BITS
+        | key_field(m_Renderer.mesh_vertex_array(mesh), VERTEX_ARRAY_BITS);
+    constexpr int STATE_BITS = SHADER_BITS + TEXTURE_BITS + VERTEX_ARRAY_BITS;
+
+    uint64_t key = key_field(static_cast<size_t>(layer), LAYER_BITS) << (64 - LAYER_BITS);
+    if (layer == RenderLayer::Opaque) {
+        key |= state << DEPTH_BITS | depth_bits;
+    }
+    else {
+        key |= (~depth_bits & 0xFFFFFFFFu) << STATE_BITS | state;
+    }
+
+    m_Entries.push_back({key, static_cast<uint32_t>(m_Packets.size())});
+    m_Packets.push_back({layer, shader, texture, mesh, range_mask, origin, query_id});
+}
+
+void RenderQueue::sort() noexcept {
+    constexpr int RADIX_BITS = 8;
+    constexpr size_t PASSES = 64 / RADIX_BITS;
+    constexpr size_t BUCKETS = size_t{1} << RADIX_BITS;
+
+    uint32_t counts[PASSES][BUCKETS]{};
+    for (const SortEntry& entry : m_Entries) {
+        for (size_t pass = 0; pass < PASSES; pass++) {
+            counts[pass][entry.key >> (pass * RADIX_BITS) & (BUCKETS - 1)]++;
+        }
+    }
+
+    m_SortScratch.resize(m_Entries.size());
+    for (size_t pass = 0; pass < PASSES; pass++) {
+        const int shift = static_cast<int>(pass * RADIX_BITS);
+        uint32_t* count = counts[pass];
+        if (m_Entries.empty() || count[m_Entries[0].key >> shift & (BUCKETS - 1)] == m_Entries.size()) continue;
+
+        uint32_t offset = 0;
+        for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+            const uint32_t bucket_count = count[bucket];
+            count[bucket] = offset;
+            offset += bucket_count;
+        }
+        for (const SortEntry& entry : m_Entries) {
+            m_SortScratch[count[entry.key >> shift & (BUCKETS - 1)]++] = entry;
+        }
+        m_Entries.swap(m_SortScratch);
+    }
+}
+
+void RenderQueue::execute() {
+    sort();
+    m_StateChanges = 0;
+
+    // Meshes are placed by their batch origin alone.
+    m_Renderer.set_camera(m_View, m_Projection);
+    m_Renderer.set_draw_block({mat4{1.0f}});
+
+    // Nothing is assumed about the state left by whatever drew last.
+    bool state_known = false;
+    ShaderHandle shader;
+    TextureHandle texture;
+    bool opaque_done = false;
+
+    m_Renderer.begin_mesh_batch();
+    for (const SortEntry& entry : m_Entries) {
+        const Packet& packet = m_Packets[entry.packet];
+
+        if (packet.layer != RenderLayer::Opaque && !opaque_done) {
+            m_Renderer.submit_mesh_batch();
+            m_Renderer.submit_query_boxes();
+            opaque_done = true;
+        }
+        if (!state_known || packet.shader != shader) {
+            m_Renderer.submit_mesh_batch();
+            m_Renderer.use_shader(packet.shader);
+            m_StateChanges++;
+            shader = packet.shader;
+        }
+        if (!state_known || packet.texture != texture) {
+            m_Renderer.submit_mesh_batch();
+            m_Renderer.bind_texture(0, packet.texture);
+            texture = packet.texture;
+            m_StateChanges++;
+        }
+        state_known = true;
+
+        m_Renderer.add_to_mesh_batch(packet.mesh, packet.range_mask, packet.origin, packet.query_id);
+    }
+    m_Renderer.submit_mesh_batch();
+    if (!opaque_done) {
+        m_Renderer.submit_query_boxes();
+    }
+}
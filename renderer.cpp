@@ -1,9 +1,15 @@
 #include "renderer.h"
 
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstring>
 #include "stb_image.h"
 #include "util.h"
 
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
 Renderer::Renderer() {
     if(SDL_Init(SDL_INIT_VIDEO) < 0){
         throw std::runtime_error("Unable to initialize SDL");
@@ -24,6 +30,37 @@ Renderer::Renderer(Renderer&& other) noexcept {
 
 Renderer::~Renderer(){
     if(m_Window){
+        glDeleteBuffers(1, &m_QuadIndices16.buffer_id);
+        glDeleteBuffers(1, &m_QuadIndices32.buffer_id);
+        glDeleteBuffers(1, &m_OriginBuffer);
+        glDeleteBuffers(1, &m_IndirectBuffer);
+        glDeleteBuffers(1, &m_CameraBuffer);
+        glDeleteBuffers(1, &m_DrawBuffer);
+        m_Stream.destroy();
+        glDeleteVertexArrays(1, &m_BoxVertexArray);
+        glDeleteBuffers(1, &m_BoxVertexBuffer);
+        glDeleteBuffers(1, &m_BoxIndexBuffer);
+        glDeleteQueries(static_cast<GLsizei>(m_Queries.size()), m_Queries.data());
+        for (ArenaPage& page : m_ArenaPages) {
+            glDeleteVertexArrays(1, &page.array_buffer_id);
+            glDeleteBuffers(1, &page.vertex_buffer_id);
+        }
+        for (Mesh& mesh : m_Meshes) {
+            if (mesh.arena_page == NO_ARENA_PAGE) {
+                glDeleteVertexArrays(1, &mesh.array_buffer_id);
+                glDeleteBuffers(2, mesh.buffers);
+            }
+        }
+        for (Shader& shader : m_Shaders) {
+            glDeleteProgram(shader.program_id);
+        }
+        for (Font& font : m_VirtualFonts) {
+            glDeleteVertexArrays(1, &font.text_array_id);
+        }
+        for (Texture& texture : m_Textures) {
+            glDeleteTextures(1, &texture.id);
+        }
+
         SDL_GL_DeleteContext(m_Context);
         SDL_DestroyWindow(m_Window);
 
@@ -58,6 +95,7 @@ RendererError Renderer::create_window(const char* title, int width, int height,
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
 
     uint32_t const flags = SDL_WINDOW_SHOWN | SDL_WINDOW_OPENGL | (SDL_WINDOW_FULLSCREEN * fullscreen);
     m_Window = SDL_CreateWindow(title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, flags);
@@ -74,7 +112,8 @@ RendererError Renderer::create_window(const char* title, int width, int height,
 
     SDL_ShowWindow(m_Window);
 
-    glViewport(0, 0, width, height);
+    m_State.viewport(0, 0, width, height);
+    m_State.set_enabled(GLCapability::DepthTest, true);
 
     m_GuiProjection = glm::ortho(0.0f, (float)width, (float)height, 0.0f);
 
@@ -94,10 +133,46 @@ RendererError Renderer::initialize_opengl() noexcept {
         return RendererError::OpenGLError;
     }
 
+    // Drivers hand out their newest core version for a 3.3 core request, so
+    // indirect drawing is usually there; Mesa's llvmpipe has it too.
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 3)) {
+        m_MultiDrawElementsIndirect = (MultiDrawElementsIndirectFunction)SDL_GL_GetProcAddress("glMultiDrawElementsIndirect");
+    }
+    if (m_MultiDrawElementsIndirect) {
+        glGenBuffers(1, &m_OriginBuffer);
+        glGenBuffers(1, &m_IndirectBuffer);
+
+        begin_mesh_batch();
+        m_State.bind_buffer(GL_ARRAY_BUFFER, m_OriginBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vec4)*m_BatchOrigins.size(), m_BatchOrigins.data(), GL_STREAM_DRAW);
+    }
+
+    m_Stream.create(m_State, STREAM_FRAME_SIZE);
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_UniformAlignment = static_cast<size_t>(std::max(alignment, 1));
+
+    glGenBuffers(1, &m_CameraBuffer);
+    m_State.bind_buffer(GL_UNIFORM_BUFFER, m_CameraBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr, GL_STREAM_DRAW);
+    m_State.bind_buffer_range(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, m_CameraBuffer, 0, sizeof(CameraBlock));
+
+    glGenBuffers(1, &m_DrawBuffer);
+    m_State.bind_buffer(GL_UNIFORM_BUFFER, m_DrawBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(DrawBlock), nullptr, GL_STREAM_DRAW);
+
+    set_draw_block({mat4{1.0f}});
+
     return RendererError::None;
 }
 
-void Renderer::swap_buffers() const noexcept {
+void Renderer::swap_buffers() noexcept {
+    m_Stream.next_frame();
+    m_DrawBlockSlot = NO_DRAW_BLOCK_SLOT;
     SDL_GL_SwapWindow(m_Window);
 }
 
@@ -110,132 +185,286 @@ void Renderer::clear() const noexcept {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
-size_t Renderer::upload_mesh(const MeshBuffer& buffer) noexcept {
-    Mesh* mesh_ptr;
+MeshHandle Renderer::upload_mesh(const MeshBuffer& buffer) noexcept {
+    const MeshHandle handle = m_Meshes.insert({});
+    Mesh& mesh = *m_Meshes.get(handle);
+
+    if (upload_arena_mesh(buffer, handle, mesh)) {
+        return handle;
+    }
+    mesh.arena_page = NO_ARENA_PAGE;
+    mesh.first_vertex = 0;
+    mesh.vertex_count = static_cast<uint32_t>(buffer.vertex_count());
+
+    glGenVertexArrays(1, &mesh.array_buffer_id);
+    m_State.bind_vertex_array(mesh.array_buffer_id);
 
-    if (m_DeadMeshes.empty()) {
-        mesh_ptr = &m_Meshes.emplace_back();
+    if (buffer.shared_quad_indices) {
+        glGenBuffers(1, &mesh.buffers[VERTEX_BUFFER]);
+        mesh.buffers[INDEX_BUFFER] = 0;
+        m_State.bind_buffer(GL_ARRAY_BUFFER, mesh.buffers[VERTEX_BUFFER]);
+        mesh.index_type = bind_quad_indices(buffer.vertex_count());
     }
     else {
-        mesh_ptr = &m_Meshes[m_DeadMeshes.top()];
-        m_DeadMeshes.pop();
+        glGenBuffers(2, mesh.buffers);
+        m_State.bind_buffer(GL_ARRAY_BUFFER, mesh.buffers[VERTEX_BUFFER]);
+        m_State.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, mesh.buffers[INDEX_BUFFER]);
+
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t)*buffer.indices.size(), buffer.indices.data(), GL_STATIC_DRAW);
+        mesh.index_type = GL_UNSIGNED_INT;
     }
 
-    Mesh& mesh = *mesh_ptr;
+    if (buffer.layout == VertexLayout::Packed) {
+        glBufferData(GL_ARRAY_BUFFER, sizeof(PackedVertex)*buffer.packed_vertices.size(), buffer.packed_vertices.data(), GL_STATIC_DRAW);
 
-    glGenVertexArrays(1, &mesh.array_buffer_id);
-    glBindVertexArray(mesh.array_buffer_id);
+        glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, sizeof(PackedVertex), (void*)0);
+        glEnableVertexAttribArray(0);
+    }
+    else {
+        glBufferData(GL_ARRAY_BUFFER, sizeof(float)*buffer.vertices.size(), buffer.vertices.data(), GL_STATIC_DRAW);
+        upload_float_vertex_layout();
+    }
 
-    glGenBuffers(2, mesh.buffers);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.buffers[VERTEX_BUFFER]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.buffers[INDEX_BUFFER]);
+    m_State.bind_vertex_array(0);
 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float)*buffer.vertices.size(), buffer.vertices.data(), GL_STATIC_DRAW);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t)*buffer.indices.size(), buffer.indices.data(), GL_STATIC_DRAW);
+    mesh.index_count = static_cast<uint32_t>(buffer.index_count());
+    std::copy(std::begin(buffer.ranges), std::end(buffer.ranges), mesh.ranges);
+    mesh.range_count = buffer.range_count;
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)OFFSET_OF_POSITION);
-    glEnableVertexAttribArray(0);
+    return handle;
+}
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)OFFSET_OF_NORMAL);
-    glEnableVertexAttribArray(1);
+bool Renderer::upload_arena_mesh(const MeshBuffer& buffer, MeshHandle handle, Mesh& mesh) noexcept {
+    const size_t vertex_count = buffer.vertex_count();
+    if (!buffer.shared_quad_indices || buffer.layout != VertexLayout::Packed
+        || vertex_count == 0 || vertex_count > 65536) {
+        return false;
+    }
 
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)OFFSET_OF_COLOR);
-    glEnableVertexAttribArray(2);
+    uint32_t page_index = 0;
+    uint32_t first_vertex = ArenaAllocator::INVALID_OFFSET;
+    for (; page_index < m_ArenaPages.size(); page_index++) {
+        first_vertex = m_ArenaPages[page_index].allocator.allocate(static_cast<uint32_t>(vertex_count));
+        if (first_vertex != ArenaAllocator::INVALID_OFFSET) break;
+    }
+    if (first_vertex == ArenaAllocator::INVALID_OFFSET) {
+        create_arena_page();
+        first_vertex = m_ArenaPages.back().allocator.allocate(static_cast<uint32_t>(vertex_count));
+    }
 
-    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)OFFSET_OF_UV);
-    glEnableVertexAttribArray(3);
+    ArenaPage& page = m_ArenaPages[page_index];
+    page.meshes.emplace(first_vertex, handle);
+
+    m_State.bind_buffer(GL_ARRAY_BUFFER, page.vertex_buffer_id);
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(PackedVertex)*first_vertex, sizeof(PackedVertex)*vertex_count, buffer.packed_vertices.data());
+
+    mesh.array_buffer_id = page.array_buffer_id;
+    mesh.buffers[VERTEX_BUFFER] = 0;
+    mesh.buffers[INDEX_BUFFER] = 0;
+    mesh.index_count = static_cast<uint32_t>(buffer.index_count());
+    mesh.index_type = GL_UNSIGNED_SHORT;
+    mesh.arena_page = page_index;
+    mesh.first_vertex = first_vertex;
+    mesh.vertex_count = static_cast<uint32_t>(vertex_count);
+    std::copy(std::begin(buffer.ranges), std::end(buffer.ranges), mesh.ranges);
+    mesh.range_count = buffer.range_count;
+    return true;
+}
+
+void Renderer::create_arena_page() noexcept {
+    ArenaPage& page = m_ArenaPages.emplace_back();
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glGenVertexArrays(1, &page.array_buffer_id);
+    m_State.bind_vertex_array(page.array_buffer_id);
 
-    mesh.index_count = static_cast<uint32_t>(buffer.indices.size());
+    glGenBuffers(1, &page.vertex_buffer_id);
+    m_State.bind_buffer(GL_ARRAY_BUFFER, page.vertex_buffer_id);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(PackedVertex)*ARENA_PAGE_VERTICES, nullptr, GL_DYNAMIC_DRAW);
+
+    glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, sizeof(PackedVertex), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    if (m_MultiDrawElementsIndirect) {
+        m_State.bind_buffer(GL_ARRAY_BUFFER, m_OriginBuffer);
+        glVertexAttribPointer(MESH_ORIGIN_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(vec4), (void*)0);
+        glVertexAttribDivisor(MESH_ORIGIN_ATTRIBUTE, 1);
+        glEnableVertexAttribArray(MESH_ORIGIN_ATTRIBUTE);
+    }
 
-    return m_Meshes.size() - 1;
+    // Every arena mesh fits the 16-bit buffer; the base vertex does the rest.
+    bind_quad_indices(65536);
+
+    m_State.bind_vertex_array(0);
 }
 
+void Renderer::compact_meshes(size_t byte_budget) noexcept {
+    size_t moved = 0;
+
+    for (ArenaPage& page : m_ArenaPages) {
+        if (page.allocator.free_space() < ARENA_COMPACT_MIN_FREE
+            || page.allocator.fragmentation() < ARENA_COMPACT_FRAGMENTATION) {
+            continue;
+        }
+
+        m_State.bind_buffer(GL_COPY_READ_BUFFER, page.vertex_buffer_id);
+        m_State.bind_buffer(GL_COPY_WRITE_BUFFER, page.vertex_buffer_id);
+
+        // Move the topmost mesh into the lowest hole below it, until there is
+        // none or the budget runs out. The free space collects at the top.
+        while (moved < byte_budget && !page.meshes.empty()) {
+            auto top = std::prev(page.meshes.end());
+            Mesh& mesh = *m_Meshes.get(top->second);
 
-MeshBuilder::MeshBuilder(MeshBuffer &target) : m_Buffer{target} {
+            const uint32_t target = page.allocator.allocate_lowest(mesh.vertex_count, mesh.first_vertex);
+            if (target == ArenaAllocator::INVALID_OFFSET) break;
 
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sizeof(PackedVertex)*mesh.first_vertex,
+                sizeof(PackedVertex)*target, sizeof(PackedVertex)*mesh.vertex_count);
+
+            page.allocator.free(mesh.first_vertex, mesh.vertex_count);
+            const MeshHandle handle = top->second;
+            page.meshes.erase(top);
+            page.meshes.emplace(target, handle);
+            mesh.first_vertex = target;
+            moved += sizeof(PackedVertex)*mesh.vertex_count;
+        }
+
+        if (moved >= byte_budget) break;
+    }
 }
 
-MeshBuilder::~MeshBuilder() {
+// Calls draw(first, count) for each run of consecutive ranges selected by
+// range_mask; meshes without ranges are one run.
+template <typename F>
+static void for_each_range_run(const Mesh& mesh, uint32_t range_mask, F&& draw) {
+    if (mesh.range_count == 0) {
+        draw(0u, mesh.index_count);
+        return;
+    }
+
+    for (uint32_t r = 0; r < mesh.range_count;) {
+        if (!(range_mask & (1u << r))) {
+            r++;
+            continue;
+        }
 
+        const uint32_t first = mesh.ranges[r].first;
+        uint32_t count = 0;
+        for (; r < mesh.range_count && (range_mask & (1u << r)); r++) {
+            count += mesh.ranges[r].count;
+        }
+        if (count != 0) {
+            draw(first, count);
+        }
+    }
 }
 
-void MeshBuilder::clear() noexcept {
-    m_Buffer.vertices.clear();
-    m_Buffer.indices.clear();
-    m_VertexCount = 0;
+void Renderer::draw_mesh_ranges(const Mesh& mesh, uint32_t range_mask) noexcept {
+    m_State.bind_vertex_array(mesh.array_buffer_id);
+    for_each_range_run(mesh, range_mask, [&](uint32_t first, uint32_t count) {
+        draw_mesh_indices(mesh, first, count);
+    });
 }
 
-void MeshBuilder::add_vertex(vec3 position, vec3 normal, vec3 color, vec2 uv) noexcept {
-    m_Buffer.vertices.push_back(position.x);
-    m_Buffer.vertices.push_back(position.y);
-    m_Buffer.vertices.push_back(position.z);
-    m_Buffer.vertices.push_back(normal.x);
-    m_Buffer.vertices.push_back(normal.y);
-    m_Buffer.vertices.push_back(normal.z);
-    m_Buffer.vertices.push_back(color.x);
-    m_Buffer.vertices.push_back(color.y);
-    m_Buffer.vertices.push_back(color.z);
-    m_Buffer.vertices.push_back(uv.x);
-    m_Buffer.vertices.push_back(uv.y);
-    m_VertexCount++;
+void Renderer::draw_mesh_indices(const Mesh& mesh, uint32_t first, uint32_t count) noexcept {
+    const size_t index_size = mesh.index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    glDrawElementsBaseVertex(GL_TRIANGLES, count, mesh.index_type, (void*)(first * index_size), mesh.first_vertex);
 }
 
-void MeshBuilder::add_index(uint32_t index) noexcept {
-    m_Buffer.indices.push_back(index);
+template <typename T>
+static std::vector<T> build_quad_indices(size_t quad_count) {
+    std::vector<T> indices;
+    indices.reserve(quad_count * std::size(QUAD_INDICES));
+    for (size_t quad = 0; quad < quad_count; quad++) {
+        for (uint32_t index : QUAD_INDICES) {
+            indices.push_back(static_cast<T>(quad * 4 + index));
+        }
+    }
+    return indices;
 }
 
-void MeshBuilder::add_triangle(vec3 position0, vec3 position1, vec3 position2, vec3 color0, vec3 color1, vec3 color2, vec2 uv0, vec2 uv1, vec2 uv2, vec3 normal) noexcept {
-    add_vertex(position0, normal, color0, uv0);
-    add_vertex(position1, normal, color1, uv1);
-    add_vertex(position2, normal, color2, uv2);
+uint32_t Renderer::bind_quad_indices(size_t vertex_count) noexcept {
+    constexpr size_t MAX_QUADS_16 = 65536 / 4;
+    constexpr size_t MIN_QUAD_CAPACITY = 1024;
 
-    add_index(m_VertexCount-3);
-    add_index(m_VertexCount-2);
-    add_index(m_VertexCount-1);
+    const size_t quad_count = vertex_count / 4;
+    const bool short_indices = quad_count <= MAX_QUADS_16;
+    QuadIndexBuffer& quads = short_indices ? m_QuadIndices16 : m_QuadIndices32;
+
+    if (quads.buffer_id == 0) {
+        glGenBuffers(1, &quads.buffer_id);
+    }
+    m_State.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, quads.buffer_id);
+
+    // Re-specifying the storage keeps the buffer name, so the VAOs already
+    // pointing at it see the larger buffer.
+    if (quad_count > quads.quad_capacity) {
+        size_t capacity = std::max({quad_count, quads.quad_capacity * 2, MIN_QUAD_CAPACITY});
+        if (short_indices) {
+            capacity = std::min(capacity, MAX_QUADS_16);
+            const std::vector<uint16_t> indices = build_quad_indices<uint16_t>(capacity);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t)*indices.size(), indices.data(), GL_STATIC_DRAW);
+        }
+        else {
+            const std::vector<uint32_t> indices = build_quad_indices<uint32_t>(capacity);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t)*indices.size(), indices.data(), GL_STATIC_DRAW);
+        }
+        quads.quad_capacity = capacity;
+    }
+
+    return short_indices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 }
 
-void MeshBuilder::add_quad(vec3 position0, vec3 position1, vec3 position2, vec3 position3, vec3 color0, vec3 color1, vec3 color2, vec3 color3, vec2 uv0, vec2 uv1, vec2 uv2, vec2 uv3, vec3 normal) noexcept {
-    add_vertex(position0, normal, color0, uv0);
-    add_vertex(position1, normal, color1, uv1);
-    add_vertex(position2, normal, color2, uv2);
-    add_vertex(position3, normal, color3, uv3);
+void Renderer::upload_float_vertex_layout() noexcept {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)OFFSET_OF_POSITION);
+    glEnableVertexAttribArray(0);
 
-    add_index(m_VertexCount-4);
-    add_index(m_VertexCount-3);
-    add_index(m_VertexCount-2);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)OFFSET_OF_NORMAL);
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)OFFSET_OF_COLOR);
+    glEnableVertexAttribArray(2);
 
-    add_index(m_VertexCount-2);
-    add_index(m_VertexCount-3);
-    add_index(m_VertexCount-1);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)OFFSET_OF_UV);
+    glEnableVertexAttribArray(3);
+
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)OFFSET_OF_TILE);
+    glEnableVertexAttribArray(4);
 }
 
+
 RendererError Renderer::create_text_shader(const char *vertex_source, const char *fragment_source) noexcept {
     if (RendererError err=compile_shader(vertex_source, fragment_source, m_FontShader); err != RendererError::None) {
         return err;
     }
 
+    // Uniforms stay with the program, so these are set once. The window,
+    // and so the projection, doesn't change size.
+    m_State.use_program(m_FontShader.program_id);
+    Shader* shader = m_CurrentShader;
+    m_CurrentShader = &m_FontShader;
+    set_uniform("u_Projection", m_GuiProjection);
+    set_uniform("u_FontAtlas", 0);
+    m_CurrentShader = shader;
+    m_State.use_program(m_CurrentShader ? m_CurrentShader->program_id : 0);
+
     return RendererError::None;
 }
 
+RendererError Renderer::create_box_shader(const char* vertex_source, const char* fragment_source) noexcept {
+    return compile_shader(vertex_source, fragment_source, m_BoxShader);
+}
+
 
-RendererError Renderer::upload_shader(const char *vertex_source, const char *fragment_source, size_t &shader_id) noexcept {
-    Shader shader;
-    if (RendererError err=compile_shader(vertex_source, fragment_source, shader); err != RendererError::None) {
+RendererError Renderer::upload_shader(const char *vertex_source, const char *fragment_source, ShaderHandle &shader) noexcept {
+    Shader compiled;
+    if (RendererError err=compile_shader(vertex_source, fragment_source, compiled); err != RendererError::None) {
         return err;
     }
 
-    if (m_DeadShaders.empty()) {
-        shader_id = m_Shaders.size();
-        m_Shaders.push_back(shader);
-    }
-    else {
-        shader_id = m_DeadShaders.top();
-        m_DeadShaders.pop();
-        m_Shaders[shader_id] = shader;
+    shader = m_Shaders.insert(std::move(compiled));
+    if (m_CurrentShaderHandle.valid()) {
+        m_CurrentShader = m_Shaders.get(m_CurrentShaderHandle);
     }
     return RendererError::None;
 }
@@ -298,116 +527,441 @@ RendererError Renderer::compile_shader(const char* vertex_source, const char* fr
         return RendererError::ShaderLinkerError;
     }
 
+    const GLuint camera_block = glGetUniformBlockIndex(prog_id, "Camera");
+    if (camera_block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(prog_id, camera_block, CAMERA_BLOCK_BINDING);
+    }
+    const GLuint draw_block = glGetUniformBlockIndex(prog_id, "Draw");
+    if (draw_block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(prog_id, draw_block, DRAW_BLOCK_BINDING);
+    }
+
     out.program_id = prog_id;
+    if (RendererError err=reflect_uniforms(out); err != RendererError::None) {
+        glDeleteProgram(prog_id);
+        out.program_id = 0;
+
+        return err;
+    }
     return RendererError::None;
 }
 
-void Renderer::use_shader(size_t shader_id) noexcept {
-    if (shader_id == -1) {
-        glUseProgram(0);
+void Renderer::use_shader(ShaderHandle shader) noexcept {
+    if (!shader.valid()) {
+        m_State.use_program(0);
         m_CurrentShader = nullptr;
+        m_CurrentShaderHandle = {};
+        return;
+    }
+    Shader* found = m_Shaders.get(shader);
+    if (!found) return;
+
+    m_State.use_program(found->program_id);
+    m_CurrentShader = found;
+    m_CurrentShaderHandle = shader;
+}
+
+void Renderer::set_camera(const mat4& view, const mat4& projection) noexcept {
+    if (m_CameraSet && m_Camera.view == view && m_Camera.projection == projection) return;
+
+    m_Camera = {projection, view, projection * view};
+    m_CameraSet = true;
+    m_State.bind_buffer(GL_UNIFORM_BUFFER, m_CameraBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), &m_Camera, GL_STREAM_DRAW);
+}
+
+void Renderer::set_draw_block(const DrawBlock& block) noexcept {
+    // The last slot written this frame is still there.
+    if (m_DrawBlockSlot != NO_DRAW_BLOCK_SLOT && m_DrawBlock.model == block.model) {
+        m_State.bind_buffer_range(GL_UNIFORM_BUFFER, DRAW_BLOCK_BINDING, m_Stream.buffer(), m_DrawBlockSlot, sizeof(DrawBlock));
         return;
     }
-    if (shader_id >= m_Shaders.size()) return;
 
-    glUseProgram(m_Shaders[shader_id].program_id);
-    m_CurrentShader = &m_Shaders[shader_id];
+    size_t offset;
+    if (!m_Stream.write(&block, sizeof(DrawBlock), m_UniformAlignment, offset)) {
+        // Orphaned like the camera block, so draws still reading the last
+        // one don't stall the upload.
+        m_State.bind_buffer(GL_UNIFORM_BUFFER, m_DrawBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(DrawBlock), &block, GL_STREAM_DRAW);
+        m_State.bind_buffer_range(GL_UNIFORM_BUFFER, DRAW_BLOCK_BINDING, m_DrawBuffer, 0, sizeof(DrawBlock));
+        m_DrawBlockSlot = NO_DRAW_BLOCK_SLOT;
+        return;
+    }
+
+    m_State.bind_buffer_range(GL_UNIFORM_BUFFER, DRAW_BLOCK_BINDING, m_Stream.buffer(), offset, sizeof(DrawBlock));
+    m_DrawBlock = block;
+    m_DrawBlockSlot = offset;
 }
 
-void Renderer::render_mesh(size_t mesh_id) noexcept {
-    if (mesh_id >= m_Meshes.size()) return;
+void Renderer::render_mesh(MeshHandle handle) noexcept {
+    const Mesh* mesh = m_Meshes.get(handle);
+    if (!mesh) return;
 
-    Mesh& mesh = m_Meshes[mesh_id];
+    m_State.bind_vertex_array(mesh->array_buffer_id);
+    draw_mesh_indices(*mesh, 0, mesh->index_count);
+}
 
-    glBindVertexArray(mesh.array_buffer_id);
-    glDrawElements(GL_TRIANGLES, mesh.index_count, GL_UNSIGNED_INT, nullptr);
+void Renderer::render_mesh_ranges(MeshHandle handle, uint32_t range_mask) noexcept {
+    const Mesh* mesh = m_Meshes.get(handle);
+    if (!mesh) return;
+
+    draw_mesh_ranges(*mesh, range_mask);
+}
+
+void Renderer::begin_mesh_batch() noexcept {
+    // Origin 0 stays the identity for arena meshes drawn outside a batch.
+    m_BatchOrigins.assign(1, vec4{0.0f, 0.0f, 0.0f, 1.0f});
+    for (auto& commands : m_BatchCommands) {
+        commands.clear();
+    }
+    m_BatchMeshes.clear();
+    m_BatchDraws.clear();
+    m_IndirectCommands.clear();
+}
+
+void Renderer::close_batch_pages() noexcept {
+    for (size_t page = 0; page < m_BatchCommands.size(); page++) {
+        auto& commands = m_BatchCommands[page];
+        if (commands.empty()) continue;
+
+        m_BatchDraws.push_back({static_cast<uint32_t>(page), NO_QUERY, m_IndirectCommands.size(), commands.size()});
+        m_IndirectCommands.insert(m_IndirectCommands.end(), commands.begin(), commands.end());
+        commands.clear();
+    }
 }
 
-uint32_t Renderer::get_loc(const std::string_view name) noexcept {
+void Renderer::add_to_mesh_batch(MeshHandle handle, uint32_t range_mask, vec4 origin, size_t query_id) noexcept {
+    const Mesh* found = m_Meshes.get(handle);
+    if (!found) return;
+    const Mesh& mesh = *found;
+    if (query_id >= m_Queries.size()) {
+        query_id = NO_QUERY;
+    }
+
+    if (!m_MultiDrawElementsIndirect || mesh.arena_page == NO_ARENA_PAGE) {
+        m_BatchMeshes.push_back({handle, range_mask, origin, query_id});
+        return;
+    }
+
+    const uint32_t origin_index = static_cast<uint32_t>(m_BatchOrigins.size());
+    m_BatchOrigins.push_back(origin);
+
+    if (query_id == NO_QUERY) {
+        if (m_BatchCommands.size() <= mesh.arena_page) {
+            m_BatchCommands.resize(mesh.arena_page + 1);
+        }
+        auto& commands = m_BatchCommands[mesh.arena_page];
+        for_each_range_run(mesh, range_mask, [&](uint32_t first, uint32_t count) {
+            commands.push_back({count, 1, first, static_cast<int32_t>(mesh.first_vertex), origin_index});
+        });
+        return;
+    }
+
+    // Whatever came before a queried mesh is drawn before it, so the batch
+    // keeps the order draws were added in, give or take the grouping by page
+    // between queried meshes.
+    close_batch_pages();
+    const size_t first_command = m_IndirectCommands.size();
+    for_each_range_run(mesh, range_mask, [&](uint32_t first, uint32_t count) {
+        m_IndirectCommands.push_back({count, 1, first, static_cast<int32_t>(mesh.first_vertex), origin_index});
+    });
+
+    // Meshes of one page added in a row under the same query share a draw.
+    const size_t command_count = m_IndirectCommands.size() - first_command;
+    if (!m_BatchDraws.empty() && m_BatchDraws.back().query_id == query_id
+        && m_BatchDraws.back().arena_page == mesh.arena_page) {
+        m_BatchDraws.back().command_count += command_count;
+    }
+    else {
+        m_BatchDraws.push_back({mesh.arena_page, query_id, first_command, command_count});
+    }
+}
+
+void Renderer::submit_mesh_batch() noexcept {
+    if (m_BatchOrigins.size() > 1) {
+        close_batch_pages();
+
+        m_State.bind_buffer(GL_ARRAY_BUFFER, m_OriginBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vec4)*m_BatchOrigins.size(), m_BatchOrigins.data(), GL_STREAM_DRAW);
+        m_State.bind_buffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand)*m_IndirectCommands.size(),
+            m_IndirectCommands.data(), GL_STREAM_DRAW);
+
+        // GL_QUERY_NO_WAIT draws when the result isn't available yet.
+        for (const BatchDraw& draw : m_BatchDraws) {
+            m_State.bind_vertex_array(m_ArenaPages[draw.arena_page].array_buffer_id);
+            if (draw.query_id != NO_QUERY) {
+                glBeginConditionalRender(m_Queries[draw.query_id], GL_QUERY_NO_WAIT);
+            }
+            m_MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT,
+                (void*)(draw.first_command * sizeof(DrawElementsIndirectCommand)),
+                static_cast<GLsizei>(draw.command_count), 0);
+            if (draw.query_id != NO_QUERY) {
+                glEndConditionalRender();
+            }
+        }
+    }
+
+    // The rest get their origin as the attribute's current value, which the
+    // shaders read wherever the VAO has no array bound to it. Meshes deleted
+    // since they were added are skipped.
+    for (const BatchedMesh& batched : m_BatchMeshes) {
+        const Mesh* mesh = m_Meshes.get(batched.mesh);
+        if (!mesh) continue;
+
+        glVertexAttrib4f(MESH_ORIGIN_ATTRIBUTE, batched.origin.x, batched.origin.y, batched.origin.z, batched.origin.w);
+        if (batched.query_id != NO_QUERY) {
+            glBeginConditionalRender(m_Queries[batched.query_id], GL_QUERY_NO_WAIT);
+        }
+        draw_mesh_ranges(*mesh, batched.range_mask);
+        if (batched.query_id != NO_QUERY) {
+            glEndConditionalRender();
+        }
+    }
+    if (!m_BatchMeshes.empty()) {
+        glVertexAttrib4f(MESH_ORIGIN_ATTRIBUTE, 0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    begin_mesh_batch();
+}
+
+size_t Renderer::create_query() noexcept {
+    uint32_t query;
+    glGenQueries(1, &query);
+
+    if (m_DeadQueries.empty()) {
+        m_Queries.push_back(query);
+        return m_Queries.size() - 1;
+    }
+    const size_t query_id = m_DeadQueries.top();
+    m_DeadQueries.pop();
+    m_Queries[query_id] = query;
+    return query_id;
+}
+
+void Renderer::delete_query(size_t query_id) noexcept {
+    if (query_id >= m_Queries.size() || m_Queries[query_id] == 0) {
+        return;
+    }
+    glDeleteQueries(1, &m_Queries[query_id]);
+    m_Queries[query_id] = 0;
+
+    m_DeadQueries.push(query_id);
+}
+
+void Renderer::add_query_box(size_t query_id, vec3 min, vec3 max) noexcept {
+    if (query_id >= m_Queries.size()) return;
+
+    m_QueryBoxIds.push_back(query_id);
+    for (int i = 0; i < 8; i++) {
+        m_QueryBoxVertices.push_back({i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z});
+    }
+}
+
+void Renderer::submit_query_boxes() noexcept {
+    if (m_QueryBoxIds.empty()) return;
+
+    if (m_BoxVertexArray == 0) {
+        // Two triangles per face of the corners above, bit 0 x, 1 y, 2 z.
+        static constexpr uint8_t BOX_INDICES[36] {
+            0, 4, 6, 0, 6, 2,   1, 3, 7, 1, 7, 5,
+            0, 1, 5, 0, 5, 4,   2, 6, 7, 2, 7, 3,
+            0, 2, 3, 0, 3, 1,   4, 5, 7, 4, 7, 6,
+        };
+
+        glGenVertexArrays(1, &m_BoxVertexArray);
+        glGenBuffers(1, &m_BoxVertexBuffer);
+        glGenBuffers(1, &m_BoxIndexBuffer);
+
+        m_State.bind_vertex_array(m_BoxVertexArray);
+        m_State.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, m_BoxIndexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(BOX_INDICES), BOX_INDICES, GL_STATIC_DRAW);
+        m_State.bind_buffer(GL_ARRAY_BUFFER, m_BoxVertexBuffer);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void*)0);
+        glEnableVertexAttribArray(0);
+    }
+    else {
+        m_State.bind_vertex_array(m_BoxVertexArray);
+        m_State.bind_buffer(GL_ARRAY_BUFFER, m_BoxVertexBuffer);
+    }
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vec3)*m_QueryBoxVertices.size(), m_QueryBoxVertices.data(), GL_STREAM_DRAW);
+
+    m_State.use_program(m_BoxShader.program_id);
+
+    m_State.color_mask(false);
+    m_State.depth_mask(false);
+    for (size_t box = 0; box < m_QueryBoxIds.size(); box++) {
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, m_Queries[m_QueryBoxIds[box]]);
+        glDrawElementsBaseVertex(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, (void*)0, static_cast<GLint>(8 * box));
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+    }
+    m_State.color_mask(true);
+    m_State.depth_mask(true);
+
+    m_State.use_program(m_CurrentShader ? m_CurrentShader->program_id : 0);
+    m_QueryBoxIds.clear();
+    m_QueryBoxVertices.clear();
+}
+
+RendererError Renderer::reflect_uniforms(Shader& shader) noexcept {
+    shader.uniforms.clear();
+
+    GLint count = 0, max_length = 0;
+    glGetProgramiv(shader.program_id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(shader.program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    std::vector<char> name(static_cast<size_t>(std::max(max_length, 1)));
+
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(shader.program_id, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+
+        // Block members have no location of their own.
+        const GLint location = glGetUniformLocation(shader.program_id, name.data());
+        if (location == -1) continue;
+
+        std::string_view view{name.data(), static_cast<size_t>(length)};
+        if (view.ends_with("[0]")) {
+            view.remove_suffix(3);
+        }
+        shader.uniforms.push_back({uniform_name_hash(view), location, type, size});
+    }
+
+    std::sort(shader.uniforms.begin(), shader.uniforms.end(), [](const ShaderUniform& a, const ShaderUniform& b) {
+        return a.name_hash < b.name_hash;
+    });
+    for (size_t i = 1; i < shader.uniforms.size(); i++) {
+        if (shader.uniforms[i].name_hash == shader.uniforms[i - 1].name_hash) {
+            fprintf(stderr, "Uniform name hash collision in program %u.\n", shader.program_id);
+            shader.uniforms.clear();
+
+            return RendererError::ShaderUniformCollision;
+        }
+    }
+    return RendererError::None;
+}
+
+uint32_t Renderer::find_uniform(const Shader& shader, uint32_t name_hash, GLenum type) noexcept {
+    const auto where = std::lower_bound(shader.uniforms.begin(), shader.uniforms.end(), name_hash,
+        [](const ShaderUniform& uniform, uint32_t hash) { return uniform.name_hash < hash; });
+    if (where == shader.uniforms.end() || where->name_hash != name_hash) {
+        return UniformHandle<int>::INVALID;
+    }
+
+    const bool sampler = where->type == GL_SAMPLER_2D || where->type == GL_SAMPLER_2D_ARRAY;
+    if (where->type != type && !(type == GL_INT && sampler)) {
+        return UniformHandle<int>::INVALID;
+    }
+    return static_cast<uint32_t>(where - shader.uniforms.begin());
+}
+
+int32_t Renderer::get_loc(UniformName name, GLenum type) const noexcept {
     if (m_CurrentShader == nullptr) {
         return -1;
     }
+    return get_loc(find_uniform(*m_CurrentShader, name.hash, type));
+}
 
-    const std::string sName{name.begin(), name.end()};
-
-    if (auto where = m_CurrentShader->uniform_cache.find(sName); where != m_CurrentShader->uniform_cache.end()) {
-        return where->second;
+int32_t Renderer::get_loc(uint32_t handle_index) const noexcept {
+    if (m_CurrentShader == nullptr || handle_index >= m_CurrentShader->uniforms.size()) {
+        return -1;
     }
-    uint32_t loc = glGetUniformLocation(m_CurrentShader->program_id, name.begin());
-    m_CurrentShader->uniform_cache[sName] = loc;
+    return m_CurrentShader->uniforms[handle_index].location;
+}
 
-    return loc;
+int32_t Renderer::get_loc(ShaderHandle shader, uint32_t handle_index) const noexcept {
+    if (shader != m_CurrentShaderHandle) {
+        return -1;
+    }
+    return get_loc(handle_index);
 }
 
-void Renderer::set_uniform(const std::string_view name, vec2 value) {
-    uint32_t loc;
-    if (loc=get_loc(name); loc == -1) {
+void Renderer::set_uniform(UniformName name, vec2 value) noexcept {
+    int32_t loc;
+    if (loc=get_loc(name, GL_FLOAT_VEC2); loc == -1) {
         return;
     }
 
     glUniform2f(loc, value.x, value.y);
 }
 
-void Renderer::set_uniform(const std::string_view name, vec3 value) {
-    uint32_t loc;
-    if (loc=get_loc(name); loc == -1) {
+void Renderer::set_uniform(UniformName name, vec3 value) noexcept {
+    int32_t loc;
+    if (loc=get_loc(name, GL_FLOAT_VEC3); loc == -1) {
         return;
     }
 
     glUniform3f(loc, value.x, value.y, value.z);
 }
 
-void Renderer::set_uniform(const std::string_view name, vec4 value) {
-    uint32_t loc;
-    if (loc=get_loc(name); loc == -1) {
+void Renderer::set_uniform(UniformName name, vec4 value) noexcept {
+    int32_t loc;
+    if (loc=get_loc(name, GL_FLOAT_VEC4); loc == -1) {
         return;
     }
 
     glUniform4f(loc, value.x, value.y, value.z, value.w);
 }
 
-void Renderer::set_uniform(const std::string_view name, int value) {
-    uint32_t loc;
-    if (loc=get_loc(name); loc == -1) {
+void Renderer::set_uniform(UniformName name, int value) noexcept {
+    int32_t loc;
+    if (loc=get_loc(name, GL_INT); loc == -1) {
         return;
     }
     glUniform1i(loc, value);
 }
 
-void Renderer::set_uniform(const std::string_view name, const mat4 &value) {
-    uint32_t loc;
-    if (loc=get_loc(name); loc == -1) {
+void Renderer::set_uniform(UniformName name, const mat4 &value) noexcept {
+    int32_t loc;
+    if (loc=get_loc(name, GL_FLOAT_MAT4); loc == -1) {
         return;
     }
 
     glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(value));
 }
 
-size_t Renderer::upload_texture(const char *file, bool v_flip) noexcept {
-    Texture* texture_ptr;
-    size_t texture_id;
-    if (m_DeadTextures.empty()) {
-        texture_id = m_Textures.size();
-        texture_ptr = &m_Textures.emplace_back();
+void Renderer::set_uniform(UniformHandle<vec2> handle, vec2 value) noexcept {
+    if (const int32_t loc = get_loc(handle.shader, handle.index); loc != -1) {
+        glUniform2f(loc, value.x, value.y);
     }
-    else {
-        texture_id = m_DeadTextures.top();
-        texture_ptr = &m_Textures[texture_id];
-        m_DeadTextures.pop();
+}
+
+void Renderer::set_uniform(UniformHandle<vec3> handle, vec3 value) noexcept {
+    if (const int32_t loc = get_loc(handle.shader, handle.index); loc != -1) {
+        glUniform3f(loc, value.x, value.y, value.z);
+    }
+}
+
+void Renderer::set_uniform(UniformHandle<vec4> handle, vec4 value) noexcept {
+    if (const int32_t loc = get_loc(handle.shader, handle.index); loc != -1) {
+        glUniform4f(loc, value.x, value.y, value.z, value.w);
     }
+}
+
+void Renderer::set_uniform(UniformHandle<mat4> handle, const mat4& value) noexcept {
+    if (const int32_t loc = get_loc(handle.shader, handle.index); loc != -1) {
+        glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(value));
+    }
+}
 
+void Renderer::set_uniform(UniformHandle<int> handle, int value) noexcept {
+    if (const int32_t loc = get_loc(handle.shader, handle.index); loc != -1) {
+        glUniform1i(loc, value);
+    }
+}
 
-    Texture& texture = *texture_ptr;
+TextureHandle Renderer::upload_texture(const char *file, bool v_flip) noexcept {
+    Texture texture{};
     stbi_set_flip_vertically_on_load(v_flip);
     unsigned char* data = stbi_load(file, &texture.width, &texture.height, &texture.channels, 0);
 
     if (!data) {
-        m_Textures.pop_back();
-        return -1;
+        return {};
     }
 
     glGenTextures(1, &texture.id);
-    glBindTexture(GL_TEXTURE_2D, texture.id);
+    m_State.bind_texture(0, texture.id);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -423,22 +977,38 @@ size_t Renderer::upload_texture(const char *file, bool v_flip) noexcept {
     glGenerateMipmap(GL_TEXTURE_2D);
     stbi_image_free(data);
 
-    return m_Textures.size() - 1;
+    return m_Textures.insert(texture);
 }
 
-void Renderer::set_sampler(const std::string_view name, int slot, size_t texture_id) {
-    if (texture_id == -1) {
+void Renderer::set_sampler(UniformName name, int slot, TextureHandle handle) noexcept {
+    const Texture* texture = m_Textures.get(handle);
+    if (!texture) {
         return;
     }
 
-    uint32_t loc;
-    if (loc=get_loc(name); loc == -1) {
+    int32_t loc;
+    if (loc=get_loc(name, GL_INT); loc == -1) {
         return;
     }
     glUniform1i(loc, slot);
 
-    glActiveTexture(GL_TEXTURE0 + slot);
-    glBindTexture(GL_TEXTURE_2D, m_Textures[texture_id].id);
+    m_State.bind_texture(slot, texture->id);
+}
+
+void Renderer::bind_texture(int slot, TextureHandle handle) noexcept {
+    const Texture* texture = m_Textures.get(handle);
+    if (!texture) {
+        return;
+    }
+
+    m_State.bind_texture(slot, texture->id);
+}
+
+uint32_t Renderer::mesh_vertex_array(MeshHandle handle) const noexcept {
+    const Mesh* mesh = m_Meshes.get(handle);
+    if (!mesh) return 0;
+
+    return mesh->arena_page == NO_ARENA_PAGE ? mesh->array_buffer_id : m_ArenaPages[mesh->arena_page].array_buffer_id;
 }
 
 size_t Renderer::upload_font(const char *filename, int size) noexcept {
@@ -504,60 +1074,61 @@ void Renderer::batch_render_text(const char* text, int x, int y, vec3 color) noe
 }
 
 void Renderer::batch_render_text_end() noexcept {
+    if (m_BatchFontID == -1) {
+        fprintf(stderr, "Batch text render not started\n");
+        return;
+    }
+
+    draw_text_vertices(m_VirtualFonts[m_BatchFontID], m_BatchTextVertices);
+}
+
+void Renderer::draw_text_vertices(Font& font, const std::vector<float>& vertices) noexcept {
     constexpr size_t FLOATS_PER_VERTEX = 2 + 2 + 3;
     constexpr size_t VERTEX_STRIDE = FLOATS_PER_VERTEX * sizeof(float);
     constexpr size_t OFFSET_OF_POS = 0;
     constexpr size_t OFFSET_OF_UV  = 2 * sizeof(float);
     constexpr size_t OFFSET_OF_COL = 4 * sizeof(float);
 
-    if (m_BatchFontID == -1) {
-        fprintf(stderr, "Batch text render not started\n");
+    // Aligned to the stride, the vertices start at a whole vertex of the
+    // attributes pointing at the start of the stream buffer.
+    size_t offset;
+    if (vertices.empty() || !m_Stream.write(vertices.data(), vertices.size() * sizeof(float), VERTEX_STRIDE, offset)) {
         return;
     }
-    Font& font = m_VirtualFonts[m_BatchFontID];
 
-    if (font.text_mesh.array_buffer_id == 0) {
-        glGenVertexArrays(1, &font.text_mesh.array_buffer_id);
-        glGenBuffers(1, font.text_mesh.buffers);
+    if (font.text_array_id == 0) {
+        glGenVertexArrays(1, &font.text_array_id);
+        m_State.bind_vertex_array(font.text_array_id);
+        m_State.bind_buffer(GL_ARRAY_BUFFER, m_Stream.buffer());
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, VERTEX_STRIDE, (void*)OFFSET_OF_POS);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, VERTEX_STRIDE, (void*)OFFSET_OF_UV);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, VERTEX_STRIDE, (void*)OFFSET_OF_COL);
     }
-    glBindVertexArray(font.text_mesh.array_buffer_id);
-    glBindBuffer(GL_ARRAY_BUFFER, font.text_mesh.buffers[0]);
-
-    glBufferData(GL_ARRAY_BUFFER, m_BatchTextVertices.size() * sizeof(float), m_BatchTextVertices.data(), GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, VERTEX_STRIDE, (void*)OFFSET_OF_POS);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, VERTEX_STRIDE, (void*)OFFSET_OF_UV);
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, VERTEX_STRIDE, (void*)OFFSET_OF_COL);
+    m_State.bind_vertex_array(font.text_array_id);
 
-    glUseProgram(m_FontShader.program_id);
+    m_State.use_program(m_FontShader.program_id);
 
-    Shader* shader = m_CurrentShader;
-    m_CurrentShader = &m_FontShader;
-
-    set_uniform("u_Projection", m_GuiProjection);
-    set_uniform("u_FontAtlas", 0);
-
-    m_CurrentShader = shader;
+    bind_texture(0, font.texture);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_Textures[font.texture_id].id);
-    glDrawArrays(GL_TRIANGLES, 0, m_BatchTextVertices.size());
+    // Text is an overlay and must not be hidden by the scene's depth.
+    m_State.set_enabled(GLCapability::DepthTest, false);
+    glDrawArrays(GL_TRIANGLES, static_cast<GLint>(offset / VERTEX_STRIDE), static_cast<GLsizei>(vertices.size() / FLOATS_PER_VERTEX));
+    m_State.set_enabled(GLCapability::DepthTest, true);
 
-    glBindVertexArray(0);
+    // m_CurrentShader is what set_uniform looks locations up in, so its
+    // program has to be the one in use again.
+    m_State.bind_vertex_array(0);
+    m_State.use_program(m_CurrentShader ? m_CurrentShader->program_id : 0);
 }
 
 void Renderer::render_text(size_t font_id, const char* text, int x, int y, vec3 color) noexcept {
     constexpr size_t VERTICES_PER_QUAD = 6;
     constexpr size_t DEFAULT_QUAD_COUNT = 50;
 
-    constexpr size_t FLOATS_PER_VERTEX = 2 + 2 + 3;
-    constexpr size_t VERTEX_STRIDE = FLOATS_PER_VERTEX * sizeof(float);
-    constexpr size_t OFFSET_OF_POS = 0;
-    constexpr size_t OFFSET_OF_UV  = 2 * sizeof(float);
-    constexpr size_t OFFSET_OF_COL = 4 * sizeof(float);
-
     static bool has_init = false;
     static std::vector<float> vertices{};
     if (!has_init) {
@@ -601,88 +1172,52 @@ void Renderer::render_text(size_t font_id, const char* text, int x, int y, vec3
         x += glyph.advance;
     }
 
-    if (font.text_mesh.array_buffer_id == 0) {
-        glGenVertexArrays(1, &font.text_mesh.array_buffer_id);
-        glGenBuffers(1, font.text_mesh.buffers);
-    }
-    glBindVertexArray(font.text_mesh.array_buffer_id);
-    glBindBuffer(GL_ARRAY_BUFFER, font.text_mesh.buffers[0]);
-
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, VERTEX_STRIDE, (void*)OFFSET_OF_POS);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, VERTEX_STRIDE, (void*)OFFSET_OF_UV);
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, VERTEX_STRIDE, (void*)OFFSET_OF_COL);
-
-    glUseProgram(m_FontShader.program_id);
-
-    Shader* shader = m_CurrentShader;
-    m_CurrentShader = &m_FontShader;
-
-    set_uniform("u_Projection", m_GuiProjection);
-    set_uniform("u_FontAtlas", 0);
-
-    m_CurrentShader = shader;
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_Textures[font.texture_id].id);
-    glDrawArrays(GL_TRIANGLES, 0, vertices.size());
-
-    glBindVertexArray(0);
-}
-
-bool Renderer::mesh_is_dead(size_t index) const {
-    return util::contains<size_t>(m_DeadMeshes.cbegin(), m_DeadMeshes.cend(), index);
-}
-bool Renderer::shader_is_dead(size_t index) const {
-    return util::contains<size_t>(m_DeadShaders.cbegin(), m_DeadShaders.cend(), index);
-}
-bool Renderer::texture_is_dead(size_t index) const {
-    return util::contains<size_t>(m_DeadTextures.cbegin(), m_DeadTextures.cend(), index);
+    draw_text_vertices(font, vertices);
 }
 
-
-void Renderer::delete_mesh(size_t index) noexcept {
-    if (index >= m_Meshes.size() || mesh_is_dead(index)) {
+void Renderer::delete_mesh(MeshHandle handle) noexcept {
+    const Mesh* found = m_Meshes.get(handle);
+    if (!found) {
         return;
     }
-    Mesh& m = m_Meshes[index];
-    glDeleteVertexArrays(1, &m.array_buffer_id);
-    glDeleteBuffers(2, m.buffers);
-
-    m.array_buffer_id = 0;
-    m.buffers[0] = 0;
-    m.buffers[1] = 0;
-
-    m_DeadMeshes.push(index);
+    const Mesh& m = *found;
+    if (m.arena_page != NO_ARENA_PAGE) {
+        ArenaPage& page = m_ArenaPages[m.arena_page];
+        page.allocator.free(m.first_vertex, m.vertex_count);
+        page.meshes.erase(m.first_vertex);
+    }
+    else {
+        glDeleteVertexArrays(1, &m.array_buffer_id);
+        glDeleteBuffers(2, m.buffers);
+        m_State.forget_vertex_array(m.array_buffer_id);
+        m_State.forget_buffer(m.buffers[VERTEX_BUFFER]);
+        m_State.forget_buffer(m.buffers[INDEX_BUFFER]);
+    }
 
+    m_Meshes.erase(handle);
 }
-void Renderer::delete_shader(size_t index) noexcept {
-    if (index >= m_Shaders.size() || shader_is_dead(index)) {
+void Renderer::delete_shader(ShaderHandle handle) noexcept {
+    const Shader* s = m_Shaders.get(handle);
+    if (!s) {
         return;
     }
-    Shader& s = m_Shaders[index];
-    s.uniform_cache.clear();
-    glDeleteProgram(s.program_id);
-    s.program_id = 0;
+    glDeleteProgram(s->program_id);
+    m_State.forget_program(s->program_id);
 
-    m_DeadShaders.push(index);
+    m_Shaders.erase(handle);
+    if (m_CurrentShaderHandle.valid()) {
+        m_CurrentShader = m_Shaders.get(m_CurrentShaderHandle);
+    }
 }
-void Renderer::delete_texture(size_t index) noexcept {
-    if (index >= m_Textures.size() || texture_is_dead(index)) {
+void Renderer::delete_texture(TextureHandle handle) noexcept {
+    const Texture* tex = m_Textures.get(handle);
+    if (!tex) {
         return;
     }
-    Texture& tex = m_Textures[index];
-    glDeleteTextures(1, &tex.id);
-
-    tex.id = 0;
-    tex.width = 0;
-    tex.height = 0;
-    tex.channels = 0;
+    glDeleteTextures(1, &tex->id);
+    m_State.forget_texture(tex->id);
 
-    m_DeadTextures.push(index);
+    m_Textures.erase(handle);
 }
 
 
@@ -753,17 +1288,17 @@ size_t Renderer::create_virtual_font(size_t font_id, int atlasWidth, int atlasHe
         SDL_FreeSurface(glyphSurf);
     }
 
-    font.texture_id = m_Textures.size(); // todo: check for dead_texture slots
-    Texture& texture = m_Textures.emplace_back();
+    Texture texture{0, atlasWidth, atlasHeight, 4};
     glGenTextures(1, &texture.id);
-    glBindTexture(GL_TEXTURE_2D, texture.id);
+    m_State.bind_texture(0, texture.id);
 
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, atlasWidth, atlasHeight, 0, GL_BGRA, GL_UNSIGNED_BYTE, surf->pixels);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    m_State.bind_texture(0, 0);
     SDL_FreeSurface(surf);
+    font.texture = m_Textures.insert(texture);
 
     return vfont_id;
 }
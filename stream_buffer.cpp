@@ -0,0 +1,106 @@
+//
+// Created by ctlf on 10/18/26.
+//
+#include "stream_buffer.h"
+
+#include <SDL2/SDL.h>
+#include <cstring>
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+void StreamBuffer::destroy() noexcept {
+    if (m_Buffer == 0) return;
+
+    for (GLsync& fence : m_Fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    glDeleteBuffers(1, &m_Buffer);
+    m_State->forget_buffer(m_Buffer);
+    m_Buffer = 0;
+    m_Mapped = nullptr;
+}
+
+void StreamBuffer::create(GLState& state, size_t frame_size) noexcept {
+    m_State = &state;
+    m_FrameSize = frame_size;
+    m_Frame = 0;
+    m_Offset = 0;
+
+    // Like glMultiDrawElementsIndirect in Renderer, newer than the context
+    // the game asks for, so loaded by hand.
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    BufferStorageFunction buffer_storage = nullptr;
+    if (major > 4 || (major == 4 && minor >= 4)) {
+        buffer_storage = (BufferStorageFunction)SDL_GL_GetProcAddress("glBufferStorage");
+    }
+
+    glGenBuffers(1, &m_Buffer);
+    m_State->bind_buffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+
+    const GLsizeiptr size = static_cast<GLsizeiptr>(FRAMES * frame_size);
+    if (buffer_storage) {
+        constexpr GLbitfield FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        buffer_storage(GL_COPY_WRITE_BUFFER, size, nullptr, FLAGS);
+        m_Mapped = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, FLAGS));
+    }
+    if (!m_Mapped) {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+}
+
+void StreamBuffer::next_frame() noexcept {
+    if (m_Buffer == 0) return;
+
+    m_Fences[m_Frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_Frame = (m_Frame + 1) % FRAMES;
+    m_Offset = m_Frame * m_FrameSize;
+
+    // Usually long signalled: the GPU rarely runs FRAMES - 1 frames behind.
+    if (GLsync& fence = m_Fences[m_Frame]; fence) {
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+void* StreamBuffer::map(size_t bytes, size_t alignment, size_t& offset) noexcept {
+    if (m_Buffer == 0) return nullptr;
+
+    const size_t start = (m_Offset + alignment - 1) / alignment * alignment;
+    if (start + bytes > (m_Frame + 1) * m_FrameSize) return nullptr;
+    offset = start;
+    m_Offset = start + bytes;
+
+    if (m_Mapped) {
+        return m_Mapped + start;
+    }
+    m_State->bind_buffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+    return glMapBufferRange(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(start), static_cast<GLsizeiptr>(bytes),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void StreamBuffer::unmap() noexcept {
+    if (m_Mapped || m_Buffer == 0) return;
+
+    m_State->bind_buffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+}
+
+bool StreamBuffer::write(const void* data, size_t bytes, size_t alignment, size_t& offset) noexcept {
+    void* target = map(bytes, alignment, offset);
+    if (!target) return false;
+
+    std::memcpy(target, data, bytes);
+    unmap();
+    return true;
+}
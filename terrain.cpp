@@ -3,65 +3,918 @@
 //
 #include "terrain.h"
 
-struct MaterialData {
-    const char* name;
-    int hardness;
-    vec3 base_color;
-};
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include "chunk_io.h"
+#include "erosion.h"
 
-#define RGB(r, g, b) vec3(r / 255.0f, g / 255.0f, b / 255.0f)
+constexpr float CHUNK_WORLD_X = static_cast<float>(VoxelEntity::CHUNK_SIZE_X * VoxelEntity::VOXEL_SIZE);
+constexpr float CHUNK_WORLD_Y = static_cast<float>(VoxelEntity::CHUNK_SIZE_Y * VoxelEntity::VOXEL_SIZE);
+constexpr float CHUNK_WORLD_Z = static_cast<float>(VoxelEntity::CHUNK_SIZE_Z * VoxelEntity::VOXEL_SIZE);
 
-static MaterialData s_MaterialTable[static_cast<size_t>(Material::INVALID)] {
-    { "air", 0, RGB(0, 0, 0)},
-    { "dirt", 3, RGB(125, 90, 69)},
-    { "stone", 10, RGB(73, 82, 81)},
-    { "grass", 3, RGB(59, 140, 74)},
-    { "wood", 7, RGB(163, 83, 59)},
-    { "iron", 15, RGB(163, 123, 111)},
-    { "copper", 12, RGB(237, 142, 52)},
+static constexpr ChunkCoord s_NeighbourOffsets[FACE_DIRECTION_COUNT] {
+    {-1, 0, 0}, {1, 0, 0},
+    {0, -1, 0}, {0, 1, 0},
+    {0, 0, -1}, {0, 0, 1},
 };
 
-VoxelEntity::VoxelEntity(int seed) {
-    if (seed != 0) {
-        std::default_random_engine::seed(seed);
+// Chunk offsets within the given radii, nearest first.
+static std::vector<ChunkCoord> sorted_offsets(int radius_xz, int radius_y) {
+    std::vector<ChunkCoord> result;
+    for (int y = -radius_y; y <= radius_y; y++) {
+        for (int z = -radius_xz; z <= radius_xz; z++) {
+            for (int x = -radius_xz; x <= radius_xz; x++) {
+                result.push_back({x, y, z});
+            }
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const ChunkCoord& a, const ChunkCoord& b) {
+        return a.x * a.x + a.y * a.y + a.z * a.z < b.x * b.x + b.y * b.y + b.z * b.z;
+    });
+    return result;
+}
+
+static const std::vector<ChunkCoord>& view_offsets() {
+    static const std::vector<ChunkCoord> offsets = sorted_offsets(VoxelEntity::VIEW_RADIUS_XZ, VoxelEntity::VIEW_RADIUS_Y);
+    return offsets;
+}
+
+// The view plus one ring, so every visible chunk has its neighbours to mesh against.
+static const std::vector<ChunkCoord>& load_offsets() {
+    static const std::vector<ChunkCoord> offsets = sorted_offsets(VoxelEntity::VIEW_RADIUS_XZ + 1, VoxelEntity::VIEW_RADIUS_Y + 1);
+    return offsets;
+}
+
+static bool in_load_range(ChunkCoord coord, ChunkCoord center) noexcept {
+    return std::abs(coord.x - center.x) <= VoxelEntity::VIEW_RADIUS_XZ + 1
+        && std::abs(coord.y - center.y) <= VoxelEntity::VIEW_RADIUS_Y + 1
+        && std::abs(coord.z - center.z) <= VoxelEntity::VIEW_RADIUS_XZ + 1;
+}
+
+// One mesher per worker thread; it holds ~200 KB of scratch.
+static ChunkMesher& thread_mesher() {
+    static thread_local std::unique_ptr<ChunkMesher> mesher = std::make_unique<ChunkMesher>();
+    return *mesher;
+}
+
+// Downsampled copies of a mesh job's chunks, one set per worker thread.
+static std::array<Chunk, 1 + FACE_DIRECTION_COUNT>& thread_lod_chunks() {
+    static thread_local auto chunks = std::make_unique<std::array<Chunk, 1 + FACE_DIRECTION_COUNT>>();
+    return *chunks;
+}
+
+static int chunk_distance(ChunkCoord a, ChunkCoord b) noexcept {
+    return std::max({std::abs(a.x - b.x), std::abs(a.y - b.y), std::abs(a.z - b.z)});
+}
+
+// LOD level for a chunk distance, with every boundary pushed out by margin.
+static uint8_t lod_for_distance(int distance, int margin) noexcept {
+    uint8_t lod = 0;
+    for (int limit : VoxelEntity::LOD_DISTANCES) {
+        if (distance > limit + margin) lod++;
+    }
+    return lod;
+}
+
+// Refines as soon as a chunk is within a level's range, coarsens only once it
+// is LOD_HYSTERESIS past it.
+static uint8_t select_lod(uint8_t current, int distance) noexcept {
+    return std::clamp(current, lod_for_distance(distance, VoxelEntity::LOD_HYSTERESIS), lod_for_distance(distance, 0));
+}
+
+// Sections on the high (or low) side of the chunk along axis.
+static uint32_t border_sections(int axis, bool high) noexcept {
+    uint32_t mask = 0;
+    for (size_t y = 0; y < CHUNK_SIZE_Y; y += SECTION_SIZE) {
+        for (size_t z = 0; z < CHUNK_SIZE_Z; z += SECTION_SIZE) {
+            for (size_t x = 0; x < CHUNK_SIZE_X; x += SECTION_SIZE) {
+                const size_t position[3] {x, y, z};
+                const size_t size[3] {CHUNK_SIZE_X, CHUNK_SIZE_Y, CHUNK_SIZE_Z};
+                if (position[axis] == (high ? size[axis] - SECTION_SIZE : 0)) {
+                    mask |= 1u << section_index(x, y, z);
+                }
+            }
+        }
+    }
+    return mask;
+}
+
+// Sections of the neighbour across face whose mesh can change when the chunk
+// goes from from_lod to to_lod: those within a voxel (for AO) of a cell of
+// the chunk's border layer that reads differently at the two levels. That
+// layer is all the neighbour meshes against.
+static uint32_t changed_border_sections(const Chunk& chunk, FaceDirection face, uint8_t from_lod, uint8_t to_lod) {
+    constexpr size_t SIZE[3] {CHUNK_SIZE_X, CHUNK_SIZE_Y, CHUNK_SIZE_Z};
+    const size_t axis = static_cast<size_t>(face) / 2;
+    const bool high = static_cast<size_t>(face) % 2 == 1;
+    const size_t u_axis = axis == 0 ? 1 : 0;
+    const size_t v_axis = axis == 2 ? 1 : 2;
+
+    const Chunk* layers[2];
+    const uint8_t lods[2] {from_lod, to_lod};
+    for (size_t i = 0; i < 2; i++) {
+        layers[i] = &chunk;
+        if (lods[i]) {
+            downsample_chunk_face(chunk, size_t{1} << lods[i], face, thread_lod_chunks()[i]);
+            layers[i] = &thread_lod_chunks()[i];
+        }
+    }
+
+    uint32_t mask = 0;
+    size_t p[3];
+    p[axis] = high ? SIZE[axis] - 1 : 0;
+    for (p[v_axis] = 0; p[v_axis] < SIZE[v_axis]; p[v_axis]++) {
+        for (p[u_axis] = 0; p[u_axis] < SIZE[u_axis]; p[u_axis]++) {
+            if (layers[0]->at(p[0], p[1], p[2]) == layers[1]->at(p[0], p[1], p[2])) continue;
+
+            size_t section[3];
+            section[axis] = high ? 0 : SIZE[axis] - SECTION_SIZE;
+            for (size_t v = p[v_axis] ? p[v_axis] - 1 : 0; v <= std::min(p[v_axis] + 1, SIZE[v_axis] - 1); v++) {
+                for (size_t u = p[u_axis] ? p[u_axis] - 1 : 0; u <= std::min(p[u_axis] + 1, SIZE[u_axis] - 1); u++) {
+                    section[u_axis] = u / SECTION_SIZE * SECTION_SIZE;
+                    section[v_axis] = v / SECTION_SIZE * SECTION_SIZE;
+                    mask |= 1u << section_index(section[0], section[1], section[2]);
+                }
+            }
+        }
+    }
+    return mask;
+}
+
+// World-space offset of each section's minimum corner within its chunk.
+static const std::array<vec3, SECTION_COUNT> s_SectionOffsets = [] {
+    std::array<vec3, SECTION_COUNT> offsets;
+    for (size_t y = 0; y < CHUNK_SIZE_Y; y += SECTION_SIZE) {
+        for (size_t z = 0; z < CHUNK_SIZE_Z; z += SECTION_SIZE) {
+            for (size_t x = 0; x < CHUNK_SIZE_X; x += SECTION_SIZE) {
+                offsets[section_index(x, y, z)] = vec3{static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)}
+                    * static_cast<float>(VoxelEntity::VOXEL_SIZE);
+            }
+        }
+    }
+    return offsets;
+}();
+
+// Face directions of a section at section_min that can face the eye: a -X
+// face lies on some plane x <= max.x and is seen only from smaller x, etc.
+// Faces exactly edge-on are dropped too.
+static uint32_t facing_directions(vec3 section_min, vec3 eye) noexcept {
+    constexpr float SECTION_WORLD = static_cast<float>(SECTION_SIZE * VoxelEntity::VOXEL_SIZE);
+    const vec3 section_max = section_min + vec3{SECTION_WORLD};
+
+    uint32_t mask = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        if (eye[axis] < section_max[axis]) mask |= 1u << (2 * axis);
+        if (eye[axis] > section_min[axis]) mask |= 1u << (2 * axis + 1);
+    }
+    return mask;
+}
+
+static int32_t floor_div(int32_t value, int32_t divisor) noexcept {
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+// The world info kept in the save directory, or one with just seed for a
+// directory diggy_worldgen never wrote to.
+static WorldInfo saved_world_info(const std::string& directory, int seed) {
+    WorldInfo info;
+    const ChunkIOError err = chunk_io::read_world_info(directory, info);
+    if (err == ChunkIOError::None) {
+        return info;
+    }
+    if (err != ChunkIOError::CouldNotOpen) {
+        fprintf(stderr, "The world info of '%s' is unreadable; generating with seed %d.\n", directory.c_str(), seed);
+    }
+    return WorldInfo{static_cast<uint32_t>(seed)};
+}
+
+VoxelEntity::VoxelEntity(Renderer& renderer, int seed, std::string save_directory)
+    : m_Renderer{renderer}, m_WorldInfo{saved_world_info(save_directory, seed)}, m_Generator{m_WorldInfo.seed},
+      m_SaveDirectory{std::move(save_directory)}, m_Workers{std::max<size_t>(1, ThreadPool::hardware_threads() - 1)} {
+    // A world pre-generated with diggy_worldgen --erosion keeps its eroded
+    // tiles there; chunks generated here, past the pre-generated box, use the
+    // same tiles (eroding missing ones on first use) so the two line up.
+    if (m_WorldInfo.erosion) {
+        m_Erosion = std::make_unique<TerrainErosion>(m_Generator, m_WorldInfo.erosion_settings, m_SaveDirectory + "/erosion");
+        m_Generator.set_erosion(m_Erosion.get());
     }
 }
 VoxelEntity::~VoxelEntity() {
+    m_Workers.wait();
+    for (auto& [coord, slot] : m_Chunks) {
+        release_meshes(*slot);
+    }
+    for (const std::vector<size_t>& pool : m_ChunkQueries) {
+        for (const size_t query : pool) {
+            m_Renderer.delete_query(query);
+        }
+    }
+}
 
+ChunkCoord VoxelEntity::chunk_coord_of(float x, float y, float z) noexcept {
+    return {
+        static_cast<int32_t>(std::floor(x / CHUNK_WORLD_X)),
+        static_cast<int32_t>(std::floor(y / CHUNK_WORLD_Y)),
+        static_cast<int32_t>(std::floor(z / CHUNK_WORLD_Z)),
+    };
 }
 
-VoxelEntity::Chunk& VoxelEntity::get_chunk(float x, float y, float z) {
-    Chunk *quadrant = nullptr;
-    // TODO
-    // Maybe start simpler
+vec3 VoxelEntity::chunk_origin(ChunkCoord coord) noexcept {
+    return {coord.x * CHUNK_WORLD_X, coord.y * CHUNK_WORLD_Y, coord.z * CHUNK_WORLD_Z};
+}
 
-    if (x >= 0 && y >= 0 && z >= 0) {
-        quadrant = Quadrant1;
+std::shared_ptr<const Chunk> VoxelEntity::load_chunk(ChunkCoord coord) const {
+    auto chunk = std::make_shared<Chunk>();
+    if (chunk_io::read_chunk(m_SaveDirectory, coord, *chunk) != ChunkIOError::None) {
+        m_Generator.generate_chunk(coord, *chunk);
     }
-    else if (x < 0 && y >= 0 && z >= 0) {
-        quadrant = Quadrant2;
+    return chunk;
+}
+
+VoxelEntity::ChunkSlot* VoxelEntity::find_chunk(ChunkCoord coord) noexcept {
+    auto where = m_Chunks.find(coord);
+    return where == m_Chunks.end() ? nullptr : where->second.get();
+}
+
+const VoxelEntity::ChunkSlot* VoxelEntity::find_chunk(ChunkCoord coord) const noexcept {
+    auto where = m_Chunks.find(coord);
+    return where == m_Chunks.end() ? nullptr : where->second.get();
+}
+
+void VoxelEntity::generate_chunk(float x, float y, float z) {
+    const ChunkCoord coord = chunk_coord_of(x, y, z);
+
+    auto chunk = std::make_shared<Chunk>();
+    m_Generator.generate_chunk(coord, *chunk);
+
+    auto& slot = m_Chunks[coord];
+    if (!slot) {
+        slot = std::make_unique<ChunkSlot>();
     }
-    else if (x < 0 && y >= 0 && z < 0) {
-        quadrant = Quadrant3;
+    slot->data = std::move(chunk);
+    mark_dirty(*slot, ALL_SECTIONS);
+    reset_visibility(*slot);
+    m_EditedChunks.push_back(coord);
+
+    for (size_t d = 0; d < FACE_DIRECTION_COUNT; d++) {
+        const ChunkCoord& offset = s_NeighbourOffsets[d];
+        const ChunkCoord neighbour_coord{coord.x + offset.x, coord.y + offset.y, coord.z + offset.z};
+        ChunkSlot* neighbour = find_chunk(neighbour_coord);
+        if (!neighbour || !neighbour->data) continue;
+
+        // The neighbour's sections on the side facing this chunk.
+        mark_dirty(*neighbour, border_sections(static_cast<int>(d / 2), d % 2 == 0));
+        m_EditedChunks.push_back(neighbour_coord);
     }
-    else if (x >= 0 && y >= 0 && z < 0) {
-        quadrant = Quadrant4;
+}
+
+bool VoxelEntity::generate_chunk_mesh(float x, float y, float z) {
+    return generate_chunk_mesh(chunk_coord_of(x, y, z));
+}
+
+bool VoxelEntity::generate_chunk_mesh(ChunkCoord coord, bool urgent) {
+    ChunkSlot* slot = find_chunk(coord);
+    if (!slot || !slot->data || !slot->dirty_sections) return false;
+
+    // Neighbours are downsampled at their own LOD level, i.e. as they are
+    // drawn, so the faces along a border between two levels still close up.
+    std::array<std::shared_ptr<const Chunk>, 1 + FACE_DIRECTION_COUNT> chunks;
+    std::array<uint8_t, 1 + FACE_DIRECTION_COUNT> lods;
+    chunks[0] = slot->data;
+    lods[0] = slot->lod;
+    for (size_t d = 0; d < FACE_DIRECTION_COUNT; d++) {
+        const ChunkCoord& offset = s_NeighbourOffsets[d];
+        const ChunkSlot* neighbour = find_chunk({coord.x + offset.x, coord.y + offset.y, coord.z + offset.z});
+        if (!neighbour || !neighbour->data) return false;
+        chunks[1 + d] = neighbour->data;
+        lods[1 + d] = neighbour->lod;
     }
-    else if (x >= 0 && y < 0 && z >= 0) {
-        quadrant = Quadrant5;
+
+    slot->connectivity_version = ++m_NextVersion;
+    MeshResult result{coord, slot->dirty_sections, {}, slot->connectivity_version, ALL_FACE_CONNECTIONS, {}, nullptr};
+    std::copy(std::begin(slot->section_versions), std::end(slot->section_versions), result.versions);
+    result.border_lod = slot->border_lod;
+    slot->border_lod = NO_LOD;
+    {
+        std::lock_guard lock{m_ResultMutex};
+        if (!m_FreeBuffers.empty()) {
+            result.buffers = std::move(m_FreeBuffers.back());
+            m_FreeBuffers.pop_back();
+        }
     }
-    else if (x < 0 && y < 0 && z >= 0) {
-        quadrant = Quadrant6;
+    if (!result.buffers) {
+        result.buffers = std::make_shared<SectionBuffers>();
+        for (MeshBuffer& buffer : result.buffers->sections) {
+            buffer.layout = VERTEX_LAYOUT;
+            buffer.shared_quad_indices = true;
+        }
     }
-    else if (x < 0 && y < 0 && z < 0) {
-        quadrant = Quadrant7;
+
+    slot->dirty_sections = 0;
+    m_JobsInFlight++;
+
+    auto job = [this, chunks = std::move(chunks), lods, result = std::move(result)]() mutable {
+        std::array<const Chunk*, 1 + FACE_DIRECTION_COUNT> sources;
+        for (size_t i = 0; i < sources.size(); i++) {
+            sources[i] = chunks[i].get();
+            if (!lods[i]) continue;
+
+            // Of a neighbour only the side facing this chunk is read.
+            Chunk& downsampled = thread_lod_chunks()[i];
+            if (i == 0) {
+                downsample_chunk(*sources[i], size_t{1} << lods[i], downsampled);
+            }
+            else {
+                const FaceDirection facing = static_cast<FaceDirection>((i - 1) ^ 1);
+                downsample_chunk_face(*sources[i], size_t{1} << lods[i], facing, downsampled);
+            }
+            sources[i] = &downsampled;
+        }
+
+        ChunkNeighbourhood neighbourhood;
+        neighbourhood.center = sources[0];
+        for (size_t d = 0; d < FACE_DIRECTION_COUNT; d++) {
+            neighbourhood.neighbours[d] = sources[1 + d];
+        }
+
+        thread_mesher().mesh_sections(neighbourhood, result.sections, result.buffers->sections);
+        result.face_connections = thread_mesher().face_connectivity(*sources[0]);
+        // Downsampled voxels may be solid where the chunk isn't.
+        result.occluder = chunk_occluder(*chunks[0]);
+
+        if (result.border_lod != NO_LOD && result.border_lod != lods[0]) {
+            for (size_t d = 0; d < FACE_DIRECTION_COUNT; d++) {
+                result.neighbour_sections[d] = changed_border_sections(*chunks[0], static_cast<FaceDirection>(d),
+                    result.border_lod, lods[0]);
+            }
+        }
+
+        std::lock_guard lock{m_ResultMutex};
+        m_MeshResults.push_back(std::move(result));
+    };
+
+    if (urgent) {
+        m_Workers.submit_front(std::move(job));
     }
     else {
-        quadrant = Quadrant8;
+        m_Workers.submit(std::move(job));
     }
+    return true;
+}
+
+void VoxelEntity::update_lods(ChunkCoord center) {
+    for (auto& [coord, slot] : m_Chunks) {
+        const uint8_t lod = select_lod(slot->lod, chunk_distance(coord, center));
+        if (lod == slot->lod) continue;
 
+        // The neighbours mesh their borders against this chunk's level, but
+        // only where its border layer comes out differently. Comparing the
+        // layers is left to the mesh job, off the main thread.
+        if (slot->border_lod == NO_LOD) {
+            slot->border_lod = slot->lod;
+        }
+        slot->lod = lod;
+        if (!slot->data) continue;
+        mark_dirty(*slot, ALL_SECTIONS);
+    }
 }
 
-void VoxelEntity::generate_chunk(float x, float y, float z) {
+void VoxelEntity::mark_dirty(ChunkSlot& slot, uint32_t sections) noexcept {
+    for (uint32_t bits = sections; bits; bits &= bits - 1) {
+        slot.section_versions[std::countr_zero(bits)] = ++m_NextVersion;
+    }
+    slot.dirty_sections |= sections;
+}
+
+void VoxelEntity::reset_visibility(ChunkSlot& slot) noexcept {
+    slot.face_connections = ALL_FACE_CONNECTIONS;
+    slot.occluder = {};
+    slot.connectivity_version = ++m_NextVersion;
+}
+
+void VoxelEntity::mark_voxel_dirty(ChunkCoord coord, int x, int y, int z) {
+    constexpr int SIZE[3] {static_cast<int>(CHUNK_SIZE_X), static_cast<int>(CHUNK_SIZE_Y), static_cast<int>(CHUNK_SIZE_Z)};
+    int local[3] {x, y, z};
+    int32_t* chunk[3] {&coord.x, &coord.y, &coord.z};
+    for (int axis = 0; axis < 3; axis++) {
+        if (local[axis] < 0) {
+            local[axis] += SIZE[axis];
+            (*chunk[axis])--;
+        }
+        else if (local[axis] >= SIZE[axis]) {
+            local[axis] -= SIZE[axis];
+            (*chunk[axis])++;
+        }
+    }
+
+    ChunkSlot* slot = find_chunk(coord);
+    if (!slot || !slot->data) return;
+
+    mark_dirty(*slot, 1u << section_index(local[0], local[1], local[2]));
+    if (std::find(m_EditedChunks.begin(), m_EditedChunks.end(), coord) == m_EditedChunks.end()) {
+        m_EditedChunks.push_back(coord);
+    }
+}
+
+Material VoxelEntity::get_voxel(int32_t x, int32_t y, int32_t z) const noexcept {
+    const ChunkCoord coord{
+        floor_div(x, static_cast<int32_t>(CHUNK_SIZE_X)),
+        floor_div(y, static_cast<int32_t>(CHUNK_SIZE_Y)),
+        floor_div(z, static_cast<int32_t>(CHUNK_SIZE_Z)),
+    };
+    const ChunkSlot* slot = find_chunk(coord);
+    if (!slot || !slot->data) return Material::INVALID;
+
+    return slot->data->at(x - coord.x * static_cast<int32_t>(CHUNK_SIZE_X),
+        y - coord.y * static_cast<int32_t>(CHUNK_SIZE_Y), z - coord.z * static_cast<int32_t>(CHUNK_SIZE_Z));
+}
+
+bool VoxelEntity::set_voxel(int32_t x, int32_t y, int32_t z, Material material) {
+    const ChunkCoord coord{
+        floor_div(x, static_cast<int32_t>(CHUNK_SIZE_X)),
+        floor_div(y, static_cast<int32_t>(CHUNK_SIZE_Y)),
+        floor_div(z, static_cast<int32_t>(CHUNK_SIZE_Z)),
+    };
+    ChunkSlot* slot = find_chunk(coord);
+    if (!slot || !slot->data) return false;
+
+    const int lx = x - coord.x * static_cast<int32_t>(CHUNK_SIZE_X);
+    const int ly = y - coord.y * static_cast<int32_t>(CHUNK_SIZE_Y);
+    const int lz = z - coord.z * static_cast<int32_t>(CHUNK_SIZE_Z);
+    if (slot->data->at(lx, ly, lz) == material) return true;
+
+    // Copy on write: in-flight mesh jobs keep reading the old chunk.
+    auto chunk = std::make_shared<Chunk>(*slot->data);
+    chunk->at(lx, ly, lz) = material;
+    slot->data = std::move(chunk);
+    reset_visibility(*slot);
+
+    // The sections of every voxel around it: face neighbours gain or lose
+    // faces against it, and all 26 read it for ambient occlusion. The mesher
+    // treats diagonal chunks as air for AO, so voxels that would lie in one
+    // aren't affected.
+    const int local[3] {lx, ly, lz};
+    constexpr int SIZE[3] {static_cast<int>(CHUNK_SIZE_X), static_cast<int>(CHUNK_SIZE_Y), static_cast<int>(CHUNK_SIZE_Z)};
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dz = -1; dz <= 1; dz++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                const int offset[3] {dx, dy, dz};
+                int outside = 0;
+                for (int axis = 0; axis < 3; axis++) {
+                    const int v = local[axis] + offset[axis];
+                    outside += v < 0 || v >= SIZE[axis];
+                }
+                if (outside > 1) continue;
+                mark_voxel_dirty(coord, lx + dx, ly + dy, lz + dz);
+            }
+        }
+    }
+    return true;
+}
+
+bool VoxelEntity::raycast(vec3 origin, vec3 direction, float max_distance, int32_t& hit_x, int32_t& hit_y, int32_t& hit_z) const noexcept {
+    const float length = glm::length(direction);
+    if (length == 0.0f) return false;
+
+    // Amanatides & Woo voxel traversal, in voxel units.
+    const vec3 start = origin / static_cast<float>(VOXEL_SIZE);
+    const vec3 step_direction = direction / length;
+    const float max_t = max_distance / static_cast<float>(VOXEL_SIZE);
+
+    int32_t voxel[3];
+    int32_t step[3];
+    float t_max[3];
+    float t_delta[3];
+    for (int axis = 0; axis < 3; axis++) {
+        voxel[axis] = static_cast<int32_t>(std::floor(start[axis]));
+        const float d = step_direction[axis];
+        step[axis] = d > 0.0f ? 1 : -1;
+        t_delta[axis] = d != 0.0f ? std::abs(1.0f / d) : INFINITY;
+        const float boundary = d > 0.0f ? static_cast<float>(voxel[axis] + 1) - start[axis] : start[axis] - static_cast<float>(voxel[axis]);
+        t_max[axis] = d != 0.0f ? boundary * t_delta[axis] : INFINITY;
+    }
+
+    for (float t = 0.0f; t <= max_t;) {
+        const Material material = get_voxel(voxel[0], voxel[1], voxel[2]);
+        if (material != Material::INVALID && material_is_solid(material)) {
+            hit_x = voxel[0];
+            hit_y = voxel[1];
+            hit_z = voxel[2];
+            return true;
+        }
+
+        const int axis = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+        voxel[axis] += step[axis];
+        t = t_max[axis];
+        t_max[axis] += t_delta[axis];
+    }
+    return false;
+}
+
+void VoxelEntity::release_mesh(ChunkSlot& slot, size_t section) noexcept {
+    if (slot.section_meshes[section].valid()) {
+        m_Renderer.delete_mesh(slot.section_meshes[section]);
+        slot.section_meshes[section] = {};
+    }
+}
+
+void VoxelEntity::release_meshes(ChunkSlot& slot) noexcept {
+    for (size_t section = 0; section < SECTION_COUNT; section++) {
+        release_mesh(slot, section);
+    }
+}
+
+void VoxelEntity::drain_loads(ChunkCoord center) {
+    std::vector<LoadResult> results;
+    {
+        std::lock_guard lock{m_ResultMutex};
+        results.swap(m_LoadResults);
+    }
+
+    for (LoadResult& result : results) {
+        m_JobsInFlight--;
+
+        // Dropped (or already reloaded) while the job ran.
+        ChunkSlot* slot = find_chunk(result.coord);
+        if (!slot || slot->data || !in_load_range(result.coord, center)) continue;
+
+        slot->data = std::move(result.data);
+        mark_dirty(*slot, ALL_SECTIONS);
+    }
+}
+
+void VoxelEntity::drain_meshes() {
+    using clock = std::chrono::steady_clock;
+    const clock::time_point start = clock::now();
+
+    while (std::chrono::duration<double, std::milli>(clock::now() - start).count() < UPLOAD_BUDGET_MS) {
+        MeshResult result;
+        {
+            std::lock_guard lock{m_ResultMutex};
+            if (m_MeshResults.empty()) break;
+            result = std::move(m_MeshResults.front());
+            m_MeshResults.pop_front();
+        }
+        m_JobsInFlight--;
+
+        // A section whose version moved on was dirtied (and requeued) while it
+        // was being meshed; the chunk may also have been unloaded.
+        for (size_t d = 0; d < FACE_DIRECTION_COUNT; d++) {
+            if (!result.neighbour_sections[d]) continue;
+
+            const ChunkCoord& offset = s_NeighbourOffsets[d];
+            ChunkSlot* neighbour = find_chunk({result.coord.x + offset.x, result.coord.y + offset.y, result.coord.z + offset.z});
+            if (neighbour && neighbour->data) {
+                mark_dirty(*neighbour, result.neighbour_sections[d]);
+            }
+        }
+
+        if (ChunkSlot* slot = find_chunk(result.coord)) {
+            if (slot->connectivity_version == result.connectivity_version) {
+                slot->face_connections = result.face_connections;
+                slot->occluder = result.occluder;
+            }
+            for (uint32_t bits = result.sections; bits; bits &= bits - 1) {
+                const size_t section = std::countr_zero(bits);
+                if (slot->section_versions[section] != result.versions[section]) continue;
+
+                release_mesh(*slot, section);
+                const MeshBuffer& buffer = result.buffers->sections[section];
+                if (buffer.index_count() != 0) {
+                    slot->section_meshes[section] = m_Renderer.upload_mesh(buffer);
+                }
+            }
+        }
+
+        std::lock_guard lock{m_ResultMutex};
+        m_FreeBuffers.push_back(std::move(result.buffers));
+    }
+}
+
+void VoxelEntity::update(float eye_x, float eye_y, float eye_z) {
+    const ChunkCoord center = chunk_coord_of(eye_x, eye_y, eye_z);
+
+    for (auto it = m_Chunks.begin(); it != m_Chunks.end();) {
+        if (!in_load_range(it->first, center)) {
+            release_meshes(*it->second);
+            it = m_Chunks.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    drain_loads(center);
+    update_lods(center);
+
+    // Edits go first and aren't capped, so they don't wait behind streaming.
+    for (const ChunkCoord& coord : m_EditedChunks) {
+        generate_chunk_mesh(coord, true);
+    }
+    m_EditedChunks.clear();
+
+    const size_t max_jobs = m_Workers.thread_count() * JOBS_PER_WORKER;
+
+    for (const ChunkCoord& offset : load_offsets()) {
+        if (m_JobsInFlight >= max_jobs) break;
+
+        const ChunkCoord coord{center.x + offset.x, center.y + offset.y, center.z + offset.z};
+        if (find_chunk(coord)) continue;
+
+        auto slot = std::make_unique<ChunkSlot>();
+        slot->lod = lod_for_distance(chunk_distance(coord, center), 0);
+        m_Chunks.emplace(coord, std::move(slot));
+        m_JobsInFlight++;
+        m_Workers.submit([this, coord] {
+            std::shared_ptr<const Chunk> data = load_chunk(coord);
+
+            std::lock_guard lock{m_ResultMutex};
+            m_LoadResults.push_back({coord, std::move(data)});
+        });
+    }
+
+    for (const ChunkCoord& offset : view_offsets()) {
+        if (m_JobsInFlight >= max_jobs) break;
+        generate_chunk_mesh({center.x + offset.x, center.y + offset.y, center.z + offset.z});
+    }
+
+    drain_meshes();
+}
+
+void VoxelEntity::find_reachable_chunks(ChunkCoord center) {
+    constexpr int32_t SIZE_XZ = 2 * VIEW_RADIUS_XZ + 1;
+    constexpr int32_t SIZE_Y = 2 * VIEW_RADIUS_Y + 1;
+    constexpr uint8_t CAMERA_CHUNK = FACE_DIRECTION_COUNT;
+    const ChunkCoord lo{center.x - VIEW_RADIUS_XZ, center.y - VIEW_RADIUS_Y, center.z - VIEW_RADIUS_XZ};
+
+    m_ReachableChunks.assign(SIZE_XZ * SIZE_XZ * SIZE_Y, 0);
+    m_ReachQueue.clear();
+    m_ReachQueue.push_back({center, CAMERA_CHUNK, 0});
+    m_ReachableChunks[VIEW_RADIUS_XZ + SIZE_XZ * (VIEW_RADIUS_XZ + SIZE_XZ * VIEW_RADIUS_Y)] = 1;
+
+    for (size_t head = 0; head < m_ReachQueue.size(); head++) {
+        const ReachStep step = m_ReachQueue[head];
+        const ChunkSlot* slot = find_chunk(step.coord);
+        const uint64_t connections = slot ? slot->face_connections : ALL_FACE_CONNECTIONS;
+
+        for (size_t d = 0; d < FACE_DIRECTION_COUNT; d++) {
+            // d ^ 1 is the opposite face.
+            if (step.directions >> (d ^ 1) & 1) continue;
+            if (step.entered_face != CAMERA_CHUNK && !(connections & face_connection_bit(step.entered_face, d))) continue;
+
+            const ChunkCoord& offset = s_NeighbourOffsets[d];
+            const ChunkCoord next{step.coord.x + offset.x, step.coord.y + offset.y, step.coord.z + offset.z};
+            const int32_t x = next.x - lo.x, y = next.y - lo.y, z = next.z - lo.z;
+            if (x < 0 || x >= SIZE_XZ || y < 0 || y >= SIZE_Y || z < 0 || z >= SIZE_XZ) continue;
+
+            uint8_t& reachable = m_ReachableChunks[x + SIZE_XZ * (z + SIZE_XZ * y)];
+            if (reachable) continue;
+            reachable = 1;
+            m_ReachQueue.push_back({next, static_cast<uint8_t>(d ^ 1), static_cast<uint8_t>(step.directions | 1u << d)});
+        }
+    }
+}
+
+void VoxelEntity::draw_occluders(ChunkCoord center) {
+    constexpr int32_t SIZE_XZ = 2 * VIEW_RADIUS_XZ + 1;
+    constexpr float BLOCK_WORLD = static_cast<float>(OCCLUDER_BLOCK * VOXEL_SIZE);
+    constexpr float VOXEL_WORLD = static_cast<float>(VOXEL_SIZE);
+    constexpr int RADIUS_Y = std::min(OCCLUDER_RADIUS, VIEW_RADIUS_Y);
+
+    for (int32_t y = center.y - RADIUS_Y; y <= center.y + RADIUS_Y; y++) {
+        for (int32_t z = center.z - OCCLUDER_RADIUS; z <= center.z + OCCLUDER_RADIUS; z++) {
+            for (int32_t x = center.x - OCCLUDER_RADIUS; x <= center.x + OCCLUDER_RADIUS; x++) {
+                const int32_t cell = (x - center.x + VIEW_RADIUS_XZ)
+                    + SIZE_XZ * ((z - center.z + VIEW_RADIUS_XZ) + SIZE_XZ * (y - center.y + VIEW_RADIUS_Y));
+                if (!m_ReachableChunks[cell]) continue;
+
+                const ChunkSlot* slot = find_chunk({x, y, z});
+                if (!slot) continue;
+
+                const ChunkOccluder& occluder = slot->occluder;
+                const vec3 origin = chunk_origin({x, y, z});
+                for (size_t cz = 0; cz < OCCLUDER_COLUMNS_Z; cz++) {
+                    for (size_t cx = 0; cx < OCCLUDER_COLUMNS_X;) {
+                        const uint8_t from = occluder.from[cz][cx];
+                        const uint8_t to = occluder.to[cz][cx];
+                        size_t end = cx + 1;
+                        while (end < OCCLUDER_COLUMNS_X && occluder.from[cz][end] == from && occluder.to[cz][end] == to) {
+                            end++;
+                        }
+
+                        if (from != to) {
+                            m_Occlusion.add_occluder(
+                                origin + vec3{cx * BLOCK_WORLD, from * VOXEL_WORLD, cz * BLOCK_WORLD},
+                                origin + vec3{end * BLOCK_WORLD, to * VOXEL_WORLD, (cz + 1) * BLOCK_WORLD});
+                        }
+                        cx = end;
+                    }
+                }
+            }
+        }
+    }
+}
+
+uint32_t VoxelEntity::meshed_sections(const ChunkSlot& slot) noexcept {
+    uint32_t mask = 0;
+    for (size_t section = 0; section < SECTION_COUNT; section++) {
+        if (slot.section_meshes[section].valid()) mask |= 1u << section;
+    }
+    return mask;
+}
+
+void VoxelEntity::add_chunk_to_queue(RenderQueue& queue, ChunkSlot& slot, vec3 origin, vec3 eye, uint32_t sections) {
+    constexpr vec3 SECTION_WORLD{static_cast<float>(SECTION_SIZE * VOXEL_SIZE)};
+
+    uint32_t visible = 0;
+    vec3 box_min{std::numeric_limits<float>::max()};
+    vec3 box_max{std::numeric_limits<float>::lowest()};
+    for (uint32_t mask = sections & meshed_sections(slot); mask != 0; mask &= mask - 1) {
+        const size_t section = std::countr_zero(mask);
+        const vec3 section_min = origin + s_SectionOffsets[section];
+        if (m_OcclusionCulling == OcclusionCulling::Software
+            && m_Occlusion.is_occluded(section_min, section_min + SECTION_WORLD)) {
+            m_CullStats.sections_occluded++;
+            continue;
+        }
+
+        visible |= 1u << section;
+        box_min = glm::min(box_min, section_min);
+        box_max = glm::max(box_max, section_min + SECTION_WORLD);
+    }
+    if (visible == 0) return;
+
+    size_t query = NO_QUERY;
+    if (m_OcclusionCulling == OcclusionCulling::Queries) {
+        box_min -= vec3{QUERY_BOX_MARGIN};
+        box_max += vec3{QUERY_BOX_MARGIN};
+        bool near_eye = true;
+        for (int axis = 0; axis < 3; axis++) {
+            near_eye &= eye[axis] > box_min[axis] - QUERY_BOX_MARGIN && eye[axis] < box_max[axis] + QUERY_BOX_MARGIN;
+        }
+
+        if (!near_eye) {
+            // Sections the last box didn't cover may have come into view.
+            if (slot.query_frame + 1 == m_Frame && (visible & ~slot.queried_sections) == 0) {
+                query = m_ChunkQueries[(m_Frame - 1) & 1][slot.query];
+            }
+
+            slot.query = next_chunk_query();
+            slot.query_frame = m_Frame;
+            slot.queried_sections = visible;
+            m_Renderer.add_query_box(m_ChunkQueries[m_Frame & 1][slot.query], box_min, box_max);
+            m_CullStats.chunks_queried++;
+        }
+    }
+
+    for (uint32_t mask = visible; mask != 0; mask &= mask - 1) {
+        const size_t section = std::countr_zero(mask);
+        const vec3 section_min = origin + s_SectionOffsets[section];
+        queue.add(RenderLayer::Opaque, m_Shader, m_Texture, slot.section_meshes[section],
+            facing_directions(section_min, eye), vec4{origin, static_cast<float>(VOXEL_SIZE)},
+            section_min + SECTION_WORLD * 0.5f, query);
+        m_CullStats.sections_visible++;
+    }
+}
+
+uint32_t VoxelEntity::next_chunk_query() {
+    std::vector<size_t>& pool = m_ChunkQueries[m_Frame & 1];
+    if (m_ChunkQueriesUsed == pool.size()) {
+        pool.push_back(m_Renderer.create_query());
+    }
+    return static_cast<uint32_t>(m_ChunkQueriesUsed++);
+}
+
+void VoxelEntity::render(RenderQueue& queue, const mat4& view_projection, float eye_x, float eye_y, float eye_z) {
+    const auto start = std::chrono::steady_clock::now();
+    const vec3 eye{eye_x, eye_y, eye_z};
+    const ChunkCoord center = chunk_coord_of(eye_x, eye_y, eye_z);
+    const Frustum frustum = extract_frustum(view_projection);
+    constexpr vec3 CHUNK_WORLD{CHUNK_WORLD_X, CHUNK_WORLD_Y, CHUNK_WORLD_Z};
+    constexpr vec3 SECTION_WORLD{static_cast<float>(SECTION_SIZE * VOXEL_SIZE)};
+    constexpr int32_t REGION = CULL_REGION_SIZE;
+
+    m_CullStats = {};
+    m_Frame++;
+    m_ChunkQueriesUsed = 0;
+    find_reachable_chunks(center);
+
+    if (m_OcclusionCulling == OcclusionCulling::Software) {
+        m_Occlusion.begin(view_projection, eye);
+        draw_occluders(center);
+        m_Occlusion.rasterize(m_Workers);
+        m_CullStats.occluder_quads = m_Occlusion.quad_count();
+    }
+
+    // The view box, cut into regions along multiples of CULL_REGION_SIZE.
+    const ChunkCoord lo{center.x - VIEW_RADIUS_XZ, center.y - VIEW_RADIUS_Y, center.z - VIEW_RADIUS_XZ};
+    const ChunkCoord hi{center.x + VIEW_RADIUS_XZ, center.y + VIEW_RADIUS_Y, center.z + VIEW_RADIUS_XZ};
+
+    // The box tests are timed on their own as well, apart from the walk
+    // around them.
+    auto cull_boxes = [&] {
+        const auto tests_start = std::chrono::steady_clock::now();
+        m_CullBoxes.cull(frustum, m_CullResults);
+        m_CullStats.boxes_tested += m_CullBoxes.size();
+        m_CullStats.frustum_milliseconds +=
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tests_start).count();
+    };
+
+    m_CullRegions.clear();
+    m_CullBoxes.clear();
+    for (int32_t ry = floor_div(lo.y, REGION); ry <= floor_div(hi.y, REGION); ry++) {
+        for (int32_t rz = floor_div(lo.z, REGION); rz <= floor_div(hi.z, REGION); rz++) {
+            for (int32_t rx = floor_div(lo.x, REGION); rx <= floor_div(hi.x, REGION); rx++) {
+                const ChunkCoord from{std::max(lo.x, rx * REGION), std::max(lo.y, ry * REGION), std::max(lo.z, rz * REGION)};
+                const ChunkCoord to{std::min(hi.x, rx * REGION + REGION - 1), std::min(hi.y, ry * REGION + REGION - 1),
+                    std::min(hi.z, rz * REGION + REGION - 1)};
+
+                m_CullRegions.push_back({from, to});
+                m_CullBoxes.add(chunk_origin(from), chunk_origin(to) + CHUNK_WORLD);
+            }
+        }
+    }
+    cull_boxes();
+
+    // Chunks of the regions that cross the frustum.
+    m_CullChunks.clear();
+    m_CullBoxes.clear();
+    for (size_t r = 0; r < m_CullRegions.size(); r++) {
+        const CullResult result = m_CullResults[r];
+        if (result == CullResult::Outside) {
+            m_CullStats.regions_culled++;
+            continue;
+        }
+
+        const CullRegion& region = m_CullRegions[r];
+        for (int32_t y = region.from.y; y <= region.to.y; y++) {
+            for (int32_t z = region.from.z; z <= region.to.z; z++) {
+                for (int32_t x = region.from.x; x <= region.to.x; x++) {
+                    ChunkSlot* slot = find_chunk(ChunkCoord{x, y, z});
+                    if (!slot || meshed_sections(*slot) == 0) continue;
+
+                    constexpr int32_t SIZE_XZ = 2 * VIEW_RADIUS_XZ + 1;
+                    if (!m_ReachableChunks[(x - lo.x) + SIZE_XZ * ((z - lo.z) + SIZE_XZ * (y - lo.y))]) {
+                        m_CullStats.chunks_hidden++;
+                        continue;
+                    }
+
+                    const vec3 origin = chunk_origin({x, y, z});
+                    if (result == CullResult::Inside) {
+                        add_chunk_to_queue(queue, *slot, origin, eye);
+                        continue;
+                    }
+                    m_CullChunks.push_back({slot, origin});
+                    m_CullBoxes.add(origin, origin + CHUNK_WORLD);
+                }
+            }
+        }
+    }
+    cull_boxes();
+
+    // Sections of the chunks that cross it; m_CullChunks keeps only those.
+    size_t crossing = 0;
+    m_CullBoxes.clear();
+    for (size_t c = 0; c < m_CullChunks.size(); c++) {
+        const CullChunk chunk = m_CullChunks[c];
+        if (m_CullResults[c] == CullResult::Outside) {
+            m_CullStats.chunks_culled++;
+            continue;
+        }
+        if (m_CullResults[c] == CullResult::Inside) {
+            add_chunk_to_queue(queue, *chunk.slot, chunk.origin, eye);
+            continue;
+        }
+
+        m_CullChunks[crossing++] = chunk;
+        for (uint32_t mask = meshed_sections(*chunk.slot); mask != 0; mask &= mask - 1) {
+            const vec3 section_min = chunk.origin + s_SectionOffsets[std::countr_zero(mask)];
+            m_CullBoxes.add(section_min, section_min + SECTION_WORLD);
+        }
+    }
+    m_CullChunks.resize(crossing);
+    cull_boxes();
+
+    // The section boxes were added in the same order.
+    size_t box = 0;
+    for (const CullChunk& chunk : m_CullChunks) {
+        uint32_t visible = 0;
+        for (uint32_t mask = meshed_sections(*chunk.slot); mask != 0; mask &= mask - 1) {
+            if (m_CullResults[box++] != CullResult::Outside) {
+                visible |= 1u << std::countr_zero(mask);
+            }
+            else {
+                m_CullStats.sections_culled++;
+            }
+        }
+        add_chunk_to_queue(queue, *chunk.slot, chunk.origin, eye, visible);
+    }
 
+    m_CullStats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 }
@@ -0,0 +1,129 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(size_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = hardware_threads();
+    }
+
+    m_Workers.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++) {
+        m_Workers.emplace_back(&ThreadPool::worker_main, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{m_Mutex};
+        m_Stopping = true;
+    }
+    m_JobReady.notify_all();
+
+    for (std::thread& worker : m_Workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::hardware_threads() noexcept {
+    const unsigned count = std::thread::hardware_concurrency();
+    return count == 0 ? 1 : count;
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard lock{m_Mutex};
+        m_Jobs.push_back(std::move(job));
+    }
+    m_JobReady.notify_one();
+}
+
+void ThreadPool::submit_front(std::function<void()> job) {
+    {
+        std::lock_guard lock{m_Mutex};
+        m_Jobs.push_front(std::move(job));
+    }
+    m_JobReady.notify_one();
+}
+
+void ThreadPool::wait() noexcept {
+    std::unique_lock lock{m_Mutex};
+    m_AllDone.wait(lock, [this] { return m_Jobs.empty() && m_Active == 0; });
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& job) {
+    run_parallel(count, job, false);
+}
+
+void ThreadPool::parallel_for_front(size_t count, const std::function<void(size_t)>& job) {
+    run_parallel(count, job, true);
+}
+
+void ThreadPool::run_parallel(size_t count, const std::function<void(size_t)>& job, bool front) {
+    // Jobs that only start after the last index was taken find nothing left
+    // and never touch job; the counters live on until they have run.
+    struct Progress {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+    };
+    auto progress = std::make_shared<Progress>();
+
+    auto run = [progress, count, job = &job] {
+        for (size_t index = progress->next++; index < count; index = progress->next++) {
+            (*job)(index);
+            if (++progress->done == count) {
+                progress->done.notify_all();
+            }
+        }
+    };
+
+    // One job per worker pulling indices keeps the queue short for large counts.
+    const size_t helpers = count > 0 ? std::min(count - 1, m_Workers.size()) : 0;
+    for (size_t i = 0; i < helpers; i++) {
+        if (front) {
+            submit_front(run);
+        }
+        else {
+            submit(run);
+        }
+    }
+    run();
+
+    for (size_t done = progress->done.load(); done < count; done = progress->done.load()) {
+        progress->done.wait(done);
+    }
+}
+
+void ThreadPool::worker_main() noexcept {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock lock{m_Mutex};
+            m_JobReady.wait(lock, [this] { return m_Stopping || !m_Jobs.empty(); });
+
+            if (m_Jobs.empty()) {
+                return;
+            }
+
+            job = std::move(m_Jobs.front());
+            m_Jobs.pop_front();
+            m_Active++;
+        }
+
+        job();
+
+        {
+            std::lock_guard lock{m_Mutex};
+            m_Active--;
+            if (m_Jobs.empty() && m_Active == 0) {
+                m_AllDone.notify_all();
+            }
+        }
+    }
+}
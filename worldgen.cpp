@@ -0,0 +1,230 @@
+//
+// Created by ctlf on 10/18/26.
+//
+
+#include "worldgen.h"
+
+#include "erosion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+
+constexpr uint32_t HEIGHT_SALT = 0x68e31da4u;
+constexpr uint32_t CAVE_SALT_A = 0xb5297a4du;
+constexpr uint32_t CAVE_SALT_B = 0x1b56c4e9u;
+constexpr uint32_t ORE_SALT = 0x7f4a7c15u;
+
+constexpr float HEIGHT_FREQUENCY = 1.0f / 256.0f;
+constexpr int HEIGHT_OCTAVES = 5;
+constexpr float CAVE_FREQUENCY_XZ = 1.0f / 48.0f;
+constexpr float CAVE_FREQUENCY_Y = 1.0f / 32.0f;
+constexpr float CAVE_RADIUS_SQ = 0.012f;
+
+static const char* s_StageNames[GENERATION_STAGE_COUNT] {
+    "heightmap",
+    "fill",
+    "caves",
+    "ores",
+};
+
+const char* generation_stage_name(GenerationStage stage) noexcept {
+    return s_StageNames[static_cast<size_t>(stage)];
+}
+
+static inline uint32_t hash3(int32_t x, int32_t y, int32_t z, uint32_t seed) noexcept {
+    uint32_t h = seed;
+    h ^= static_cast<uint32_t>(x) * 0x8da6b343u;
+    h ^= static_cast<uint32_t>(y) * 0xd8163841u;
+    h ^= static_cast<uint32_t>(z) * 0xcb1ab31fu;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+// Hashed lattice value in [-1, 1].
+static inline float lattice(int32_t x, int32_t y, int32_t z, uint32_t seed) noexcept {
+    return static_cast<float>(hash3(x, y, z, seed) & 0xFFFF) * (2.0f / 65535.0f) - 1.0f;
+}
+
+static inline float smooth(float t) noexcept {
+    return t * t * (3.0f - 2.0f * t);
+}
+
+static inline float lerp(float a, float b, float t) noexcept {
+    return a + (b - a) * t;
+}
+
+static float value_noise2(float x, float z, uint32_t seed) noexcept {
+    const float fx = std::floor(x);
+    const float fz = std::floor(z);
+    const int32_t ix = static_cast<int32_t>(fx);
+    const int32_t iz = static_cast<int32_t>(fz);
+    const float tx = smooth(x - fx);
+    const float tz = smooth(z - fz);
+
+    const float v00 = lattice(ix, 0, iz, seed);
+    const float v10 = lattice(ix + 1, 0, iz, seed);
+    const float v01 = lattice(ix, 0, iz + 1, seed);
+    const float v11 = lattice(ix + 1, 0, iz + 1, seed);
+
+    return lerp(lerp(v00, v10, tx), lerp(v01, v11, tx), tz);
+}
+
+static float value_noise3(float x, float y, float z, uint32_t seed) noexcept {
+    const float fx = std::floor(x);
+    const float fy = std::floor(y);
+    const float fz = std::floor(z);
+    const int32_t ix = static_cast<int32_t>(fx);
+    const int32_t iy = static_cast<int32_t>(fy);
+    const int32_t iz = static_cast<int32_t>(fz);
+    const float tx = smooth(x - fx);
+    const float ty = smooth(y - fy);
+    const float tz = smooth(z - fz);
+
+    const float x00 = lerp(lattice(ix, iy, iz, seed), lattice(ix + 1, iy, iz, seed), tx);
+    const float x10 = lerp(lattice(ix, iy + 1, iz, seed), lattice(ix + 1, iy + 1, iz, seed), tx);
+    const float x01 = lerp(lattice(ix, iy, iz + 1, seed), lattice(ix + 1, iy, iz + 1, seed), tx);
+    const float x11 = lerp(lattice(ix, iy + 1, iz + 1, seed), lattice(ix + 1, iy + 1, iz + 1, seed), tx);
+
+    return lerp(lerp(x00, x10, ty), lerp(x01, x11, ty), tz);
+}
+
+WorldGenerator::WorldGenerator(uint32_t seed) : m_Seed{seed} {
+
+}
+
+float WorldGenerator::raw_height(int32_t world_x, int32_t world_z) const noexcept {
+    float x = static_cast<float>(world_x) * HEIGHT_FREQUENCY;
+    float z = static_cast<float>(world_z) * HEIGHT_FREQUENCY;
+
+    float sum = 0.0f;
+    float amplitude = 1.0f;
+    float total = 0.0f;
+    for (int octave = 0; octave < HEIGHT_OCTAVES; octave++) {
+        sum += value_noise2(x, z, m_Seed ^ (HEIGHT_SALT + octave)) * amplitude;
+        total += amplitude;
+        amplitude *= 0.5f;
+        x *= 2.0f;
+        z *= 2.0f;
+    }
+
+    return BASE_HEIGHT + sum / total * HEIGHT_AMPLITUDE;
+}
+
+int WorldGenerator::surface_height(int32_t world_x, int32_t world_z) const noexcept {
+    float relative = raw_height(world_x, world_z) - BASE_HEIGHT;
+    if (m_Erosion) {
+        relative += m_Erosion->height_offset(world_x, world_z);
+    }
+
+    return BASE_HEIGHT + static_cast<int>(relative);
+}
+
+void WorldGenerator::generate_chunk(ChunkCoord coord, Chunk& out, GenerationTimings* timings) const noexcept {
+    using clock = std::chrono::steady_clock;
+
+    clock::time_point stage_start = clock::now();
+    auto end_stage = [&](GenerationStage stage) {
+        if (!timings) return;
+        const clock::time_point now = clock::now();
+        timings->seconds[static_cast<size_t>(stage)] += std::chrono::duration<double>(now - stage_start).count();
+        stage_start = now;
+    };
+
+    const int32_t base_x = coord.x * static_cast<int32_t>(CHUNK_SIZE_X);
+    const int32_t base_y = coord.y * static_cast<int32_t>(CHUNK_SIZE_Y);
+    const int32_t base_z = coord.z * static_cast<int32_t>(CHUNK_SIZE_Z);
+    const int32_t top_y = base_y + static_cast<int32_t>(CHUNK_SIZE_Y) - 1;
+
+    int heights[CHUNK_SIZE_X * CHUNK_SIZE_Z];
+    int max_height = INT_MIN;
+
+    // As surface_height, with the erosion tiles looked up once for the chunk.
+    float offsets[CHUNK_SIZE_X * CHUNK_SIZE_Z] {};
+    if (m_Erosion) {
+        m_Erosion->height_offsets(base_x, base_z, CHUNK_SIZE_X, CHUNK_SIZE_Z, offsets);
+    }
+
+    for (size_t z = 0; z < CHUNK_SIZE_Z; z++) {
+        for (size_t x = 0; x < CHUNK_SIZE_X; x++) {
+            const float relative = raw_height(base_x + static_cast<int32_t>(x), base_z + static_cast<int32_t>(z)) - BASE_HEIGHT
+                + offsets[x + z * CHUNK_SIZE_X];
+            const int h = BASE_HEIGHT + static_cast<int>(relative);
+            heights[x + z * CHUNK_SIZE_X] = h;
+            max_height = std::max(max_height, h);
+        }
+    }
+    end_stage(GenerationStage::Heightmap);
+
+    for (size_t y = 0; y < CHUNK_SIZE_Y; y++) {
+        const int wy = base_y + static_cast<int32_t>(y);
+        Material* layer = &out.voxels[Chunk::index(0, y, 0)];
+
+        for (size_t i = 0; i < CHUNK_SIZE_X * CHUNK_SIZE_Z; i++) {
+            const int h = heights[i];
+            Material m;
+            if (wy > h) m = Material::Void;
+            else if (wy == h) m = Material::Grass;
+            else if (wy > h - DIRT_DEPTH) m = Material::Dirt;
+            else m = Material::Stone;
+            layer[i] = m;
+        }
+    }
+    end_stage(GenerationStage::Fill);
+
+    // Caves are the intersection of two noise iso-surfaces, which gives long
+    // winding tunnels rather than blobs. Nothing above the dirt layer is carved.
+    if (top_y > CAVE_FLOOR && base_y <= max_height - DIRT_DEPTH) {
+        for (size_t y = 0; y < CHUNK_SIZE_Y; y++) {
+            const int wy = base_y + static_cast<int32_t>(y);
+            if (wy <= CAVE_FLOOR) continue;
+
+            for (size_t z = 0; z < CHUNK_SIZE_Z; z++) {
+                for (size_t x = 0; x < CHUNK_SIZE_X; x++) {
+                    if (wy > heights[x + z * CHUNK_SIZE_X] - DIRT_DEPTH) continue;
+
+                    const float fx = static_cast<float>(base_x + static_cast<int32_t>(x)) * CAVE_FREQUENCY_XZ;
+                    const float fy = static_cast<float>(wy) * CAVE_FREQUENCY_Y;
+                    const float fz = static_cast<float>(base_z + static_cast<int32_t>(z)) * CAVE_FREQUENCY_XZ;
+
+                    const float a = value_noise3(fx, fy, fz, m_Seed ^ CAVE_SALT_A);
+                    if (a * a >= CAVE_RADIUS_SQ) continue;
+                    const float b = value_noise3(fx, fy, fz, m_Seed ^ CAVE_SALT_B);
+
+                    if (a * a + b * b < CAVE_RADIUS_SQ) {
+                        out.at(x, y, z) = Material::Void;
+                    }
+                }
+            }
+        }
+    }
+    end_stage(GenerationStage::Caves);
+
+    if (base_y <= max_height - DIRT_DEPTH) {
+        for (size_t y = 0; y < CHUNK_SIZE_Y; y++) {
+            const int wy = base_y + static_cast<int32_t>(y);
+
+            // Copper sits near the surface, iron deeper down.
+            const uint32_t copper_chance = wy > -64 ? 6 : 0;
+            const uint32_t iron_chance = wy < -16 ? 8 : 0;
+
+            for (size_t z = 0; z < CHUNK_SIZE_Z; z++) {
+                for (size_t x = 0; x < CHUNK_SIZE_X; x++) {
+                    Material& m = out.at(x, y, z);
+                    if (m != Material::Stone) continue;
+
+                    const uint32_t roll = hash3(base_x + static_cast<int32_t>(x), wy,
+                        base_z + static_cast<int32_t>(z), m_Seed ^ ORE_SALT) & 1023;
+                    if (roll < copper_chance) m = Material::Copper;
+                    else if (roll < copper_chance + iron_chance) m = Material::Iron;
+                }
+            }
+        }
+    }
+    end_stage(GenerationStage::Ores);
+}
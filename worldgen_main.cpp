@@ -0,0 +1,301 @@
+//
+// Created by ctlf on 10/18/26.
+//
+// diggy_worldgen: pre-generates a box of chunks into the on-disk chunk format.
+// Runs headless (no SDL, no GL). Chunks that already exist on disk are skipped,
+// so an interrupted run is resumed by running the same command again. The
+// seed and erosion settings are kept in DIR/world.info, and a run with other
+// ones is refused rather than mixing two worlds.
+//
+// --erosion erodes the heightmap tiles covering the box up front (cached in
+// DIR/erosion) before any chunk is generated; the game then erodes chunks it
+// generates outside the box from the same tiles. --erosion-bench only measures
+// tile throughput for increasing thread counts.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chunk_io.h"
+#include "erosion.h"
+#include "thread_pool.h"
+#include "worldgen.h"
+
+static volatile std::sig_atomic_t s_Interrupted = 0;
+
+static void handle_interrupt(int) {
+    s_Interrupted = 1;
+}
+
+struct Options {
+    std::string output = "world";
+    uint32_t seed = 0;
+    ChunkCoord from{-8, -4, -8};
+    ChunkCoord to{7, 1, 7};
+    size_t threads = 0;
+    bool erosion = false;
+    bool erosion_bench = false;
+};
+
+static void print_usage(const char* program) {
+    fprintf(stderr,
+        "usage: %s [--out DIR] [--seed N] [--from X,Y,Z] [--to X,Y,Z] [--threads N] [--erosion] [--erosion-bench]\n"
+        "  Generates every chunk in the inclusive box [from, to] into DIR.\n"
+        "  Re-running with the same arguments resumes an interrupted run.\n",
+        program);
+}
+
+static bool parse_coord(const char* text, ChunkCoord& out) {
+    return sscanf(text, "%d,%d,%d", &out.x, &out.y, &out.z) == 3;
+}
+
+static bool parse_options(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (std::strcmp(arg, "--out") == 0 && has_value) {
+            options.output = argv[++i];
+        }
+        else if (std::strcmp(arg, "--seed") == 0 && has_value) {
+            options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(arg, "--from") == 0 && has_value) {
+            if (!parse_coord(argv[++i], options.from)) return false;
+        }
+        else if (std::strcmp(arg, "--to") == 0 && has_value) {
+            if (!parse_coord(argv[++i], options.to)) return false;
+        }
+        else if (std::strcmp(arg, "--threads") == 0 && has_value) {
+            options.threads = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(arg, "--erosion") == 0) {
+            options.erosion = true;
+        }
+        else if (std::strcmp(arg, "--erosion-bench") == 0) {
+            options.erosion_bench = true;
+        }
+        else {
+            return false;
+        }
+    }
+
+    return options.from.x <= options.to.x && options.from.y <= options.to.y && options.from.z <= options.to.z;
+}
+
+static void run_erosion_bench(const Options& options) {
+    using clock = std::chrono::steady_clock;
+
+    const WorldGenerator generator{options.seed};
+    const TerrainErosion erosion{generator};
+
+    const size_t max_threads = options.threads ? options.threads : ThreadPool::hardware_threads();
+    std::vector<size_t> thread_counts;
+    for (size_t t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(max_threads);
+
+    printf("Erosion throughput, %dx%d tiles (%d core + %d border):\n",
+        TerrainErosion::TILE_SPAN, TerrainErosion::TILE_SPAN, TerrainErosion::TILE_SIZE, TerrainErosion::TILE_BORDER);
+
+    double single_thread_rate = 0.0;
+    for (size_t threads : thread_counts) {
+        ThreadPool pool{threads};
+        const size_t tiles = std::max<size_t>(4, threads * 2);
+
+        const clock::time_point start = clock::now();
+        pool.parallel_for(tiles, [&](size_t i) {
+            std::vector<float> offsets;
+            erosion.erode_tile(static_cast<int32_t>(i), 0, offsets);
+        });
+        const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+        const double rate = tiles / seconds;
+        if (threads == 1) single_thread_rate = rate;
+
+        printf("  %3zu thread(s): %2zu tiles in %6.3fs  %6.2f tiles/s  %5.2fx\n",
+            threads, tiles, seconds, rate, single_thread_rate > 0.0 ? rate / single_thread_rate : 1.0);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (options.erosion_bench) {
+        run_erosion_bench(options);
+        return 0;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(options.output, ec);
+    if (ec) {
+        fprintf(stderr, "Could not create output directory '%s': %s\n", options.output.c_str(), ec.message().c_str());
+        return 1;
+    }
+
+    if (size_t removed = chunk_io::remove_partial_files(options.output); removed > 0) {
+        printf("Removed %zu partial chunk file(s) from an interrupted run.\n", removed);
+    }
+
+    // Chunks already there are only skipped when they come from the same
+    // world; the game reads the same file to carry on past the box.
+    const WorldInfo info{options.seed, options.erosion, ErosionSettings{}};
+    WorldInfo existing;
+    if (ChunkIOError err = chunk_io::read_world_info(options.output, existing); err == ChunkIOError::CouldNotOpen) {
+        if (chunk_io::write_world_info(options.output, info) != ChunkIOError::None) {
+            fprintf(stderr, "Could not write the world info of '%s'.\n", options.output.c_str());
+            return 1;
+        }
+    }
+    else if (err != ChunkIOError::None) {
+        fprintf(stderr, "The world info of '%s' is unreadable.\n", options.output.c_str());
+        return 1;
+    }
+    else if (existing != info) {
+        fprintf(stderr, "'%s' holds a world generated with seed %u%s; run with the same settings or another --out.\n",
+            options.output.c_str(), existing.seed, existing.erosion ? " and --erosion" : " without --erosion");
+        return 1;
+    }
+
+    std::vector<ChunkCoord> pending;
+    size_t skipped = 0;
+    for (int32_t y = options.from.y; y <= options.to.y; y++) {
+        for (int32_t z = options.from.z; z <= options.to.z; z++) {
+            for (int32_t x = options.from.x; x <= options.to.x; x++) {
+                const ChunkCoord coord{x, y, z};
+                if (chunk_io::chunk_exists(options.output, coord)) {
+                    skipped++;
+                    continue;
+                }
+                pending.push_back(coord);
+            }
+        }
+    }
+
+    ThreadPool pool{options.threads};
+    printf("Generating %zu chunk(s) into '%s' with seed %u on %zu thread(s), %zu already present.\n",
+        pending.size(), options.output.c_str(), options.seed, pool.thread_count(), skipped);
+
+    std::signal(SIGINT, handle_interrupt);
+    std::signal(SIGTERM, handle_interrupt);
+
+    WorldGenerator generator{options.seed};
+    TerrainErosion erosion{generator, info.erosion_settings, options.erosion ? options.output + "/erosion" : ""};
+
+    if (options.erosion && !pending.empty()) {
+        generator.set_erosion(&erosion);
+
+        const int32_t min_tile_x = TerrainErosion::tile_of(options.from.x * static_cast<int32_t>(CHUNK_SIZE_X));
+        const int32_t min_tile_z = TerrainErosion::tile_of(options.from.z * static_cast<int32_t>(CHUNK_SIZE_Z));
+        const int32_t max_tile_x = TerrainErosion::tile_of((options.to.x + 1) * static_cast<int32_t>(CHUNK_SIZE_X) - 1);
+        const int32_t max_tile_z = TerrainErosion::tile_of((options.to.z + 1) * static_cast<int32_t>(CHUNK_SIZE_Z) - 1);
+
+        // Tiles on the edge of the box are blended with their outer neighbours too.
+        const auto erosion_start = std::chrono::steady_clock::now();
+        erosion.prepare(min_tile_x - 1, min_tile_z - 1, max_tile_x + 1, max_tile_z + 1, pool);
+        const double erosion_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - erosion_start).count();
+
+        printf("Prepared %zu eroded heightmap tile(s) in %.2fs.\n", erosion.tiles_cached(), erosion_seconds);
+    }
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> generated{0};
+    std::atomic<size_t> failed{0};
+
+    std::mutex timings_mutex;
+    GenerationTimings timings{};
+    double write_seconds = 0.0;
+
+    using clock = std::chrono::steady_clock;
+    const clock::time_point start = clock::now();
+
+    const size_t workers = std::min(pending.size(), pool.thread_count());
+    for (size_t w = 0; w < workers; w++) {
+        pool.submit([&] {
+            auto chunk = std::make_unique<Chunk>();
+            GenerationTimings local_timings{};
+            double local_write_seconds = 0.0;
+
+            for (size_t i = next++; i < pending.size() && !s_Interrupted; i = next++) {
+                generator.generate_chunk(pending[i], *chunk, &local_timings);
+
+                const clock::time_point write_start = clock::now();
+                if (chunk_io::write_chunk(options.output, pending[i], *chunk) != ChunkIOError::None) {
+                    failed++;
+                }
+                else {
+                    generated++;
+                }
+                local_write_seconds += std::chrono::duration<double>(clock::now() - write_start).count();
+            }
+
+            std::lock_guard lock{timings_mutex};
+            timings += local_timings;
+            write_seconds += local_write_seconds;
+        });
+    }
+
+    size_t last_reported = 0;
+    clock::time_point last_report_time = start;
+    while (generated + failed < pending.size() && !s_Interrupted) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        const clock::time_point now = clock::now();
+        if (now - last_report_time < std::chrono::seconds(1)) {
+            continue;
+        }
+        last_report_time = now;
+
+        const size_t done = generated + failed;
+        const double elapsed = std::chrono::duration<double>(now - start).count();
+        const double rate = done / elapsed;
+        const double eta = rate > 0.0 ? (pending.size() - done) / rate : 0.0;
+
+        printf("  %zu/%zu chunks, %.1f chunks/s (last second: %zu), ETA %.0fs\n",
+            done, pending.size(), rate, done - last_reported, eta);
+        fflush(stdout);
+        last_reported = done;
+    }
+
+    pool.wait();
+
+    const double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    const size_t done = generated;
+
+    printf("\n%zu chunk(s) generated, %zu failed, %zu skipped in %.2fs (%.1f chunks/s).\n",
+        done, failed.load(), skipped, elapsed, elapsed > 0.0 ? done / elapsed : 0.0);
+
+    if (done > 0) {
+        double total = write_seconds;
+        for (double seconds : timings.seconds) total += seconds;
+
+        printf("Per-stage time (summed over threads):\n");
+        for (size_t s = 0; s < GENERATION_STAGE_COUNT; s++) {
+            printf("  %-10s %9.3fs  %8.3f ms/chunk  %5.1f%%\n",
+                generation_stage_name(static_cast<GenerationStage>(s)), timings.seconds[s],
+                timings.seconds[s] * 1000.0 / done, timings.seconds[s] * 100.0 / total);
+        }
+        printf("  %-10s %9.3fs  %8.3f ms/chunk  %5.1f%%\n",
+            "write", write_seconds, write_seconds * 1000.0 / done, write_seconds * 100.0 / total);
+    }
+
+    if (s_Interrupted) {
+        printf("Interrupted; run the same command again to resume.\n");
+        return 2;
+    }
+
+    return failed == 0 ? 0 : 1;
+}